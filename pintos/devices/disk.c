@@ -3,10 +3,14 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -28,10 +32,26 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses [IDE-BM].  Only meaningful if
+   the channel has a bus master, i.e. if bm_base is nonzero. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start/stop bus master. */
+#define BM_CMD_READ 0x08        /* 1=disk to memory, 0=memory to disk. */
+
+/* Bus master Status Register bits.  ERROR and INTR are cleared
+   by writing 1 to them. */
+#define BM_STA_ERROR 0x02       /* Transfer failed. */
+#define BM_STA_INTR 0x04        /* Device raised its interrupt. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +67,39 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA with retries. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA with retries. */
+
+/* Most sectors that one READ or WRITE command can move.  The
+   sector count register is 8 bits wide and 0 means 256. */
+#define CMD_SECTOR_MAX 256
+
+/* Most queued requests merged into one transfer. */
+#define BATCH_MAX 16
+
+/* How long the deadline scheduler lets a request wait, in timer
+   ticks, before serving it ahead of the elevator order.  Reads
+   get a short deadline because a thread is usually stalled on
+   them; writes are mostly writeback. */
+#define READ_DEADLINE (TIMER_FREQ / 20)
+#define WRITE_DEADLINE (TIMER_FREQ / 2)
+
+/* A physical region descriptor: one contiguous piece of memory
+   for the bus master to transfer to or from.  A region may not
+   cross a 64 kB boundary, and a SIZE of 0 means 64 kB. */
+struct prd {
+	uint32_t addr;              /* Physical address, even. */
+	uint16_t size;              /* Byte count, even. */
+	uint16_t flags;             /* PRD_EOT on the last entry. */
+};
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Number of descriptors in each channel's PRD table.  Half a page
+   per channel, so the table never crosses a 64 kB boundary. */
+#define PRDT_CNT (PGSIZE / 2 / sizeof (struct prd))
 
 /* An ATA device. */
 struct disk {
@@ -56,9 +109,14 @@ struct disk {
 
 	bool is_ata;                /* 1=This device is an ATA disk. */
 	disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+	bool use_dma;               /* True to try bus master DMA first. */
+	size_t multiple;            /* Sectors per PIO interrupt, 0 if the disk
+								   does not do READ/WRITE MULTIPLE. */
 
 	long long read_cnt;         /* Number of sectors read. */
 	long long write_cnt;        /* Number of sectors written. */
+	long long dma_cnt;          /* Sectors of the above moved by DMA. */
+	struct diskstat stats;      /* Protected by the channel's lock. */
 };
 
 /* An ATA channel (aka controller).
@@ -67,12 +125,30 @@ struct channel {
 	char name[8];               /* Name, e.g. "hd0". */
 	uint16_t reg_base;          /* Base I/O port. */
 	uint8_t irq;                /* Interrupt in use. */
+	uint16_t bm_base;           /* Bus master I/O port, 0 if none. */
+	struct prd *prdt;           /* PRD table, if bm_base is nonzero. */
 
-	struct lock lock;           /* Must acquire to access the controller. */
 	bool expecting_interrupt;   /* True if an interrupt is expected, false if
 								   any interrupt would be spurious. */
 	struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+	/* Request queue.  Only the channel's worker thread touches the
+	   controller once disk_init() returns; everyone else queues
+	   requests for it. */
+	struct lock lock;           /* Protects the members below. */
+	struct condition queue_ready;   /* Signaled when `queue' gains a request. */
+	struct list queue;          /* Pending struct disk_requests, oldest first. */
+	uint64_t head;              /* Elevator position, see request_key(). */
+
+	/* Queue statistics. */
+	size_t depth;               /* Requests queued now. */
+	size_t max_depth;           /* Most requests ever queued at once. */
+	long long depth_sum;        /* Sum of `depth' seen by each submit. */
+	long long submit_cnt;       /* Requests submitted. */
+	long long batch_cnt;        /* Transfers issued to the disk. */
+	long long merge_cnt;        /* Requests merged into another's transfer. */
+	long long complete_cnt;     /* Requests completed. */
+
 	struct disk devices[2];     /* The devices on this channel. */
 };
 
@@ -84,10 +160,54 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
-static void select_sector (struct disk *, disk_sector_t);
+/* One or more queued requests for consecutive sectors of one
+   disk, all reads or all writes, that the worker moves as a
+   single run. */
+struct transfer {
+	struct disk *disk;          /* Disk. */
+	disk_sector_t sec_no;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	bool write;                 /* True to write, false to read. */
+	struct disk_request *reqs[BATCH_MAX];   /* Requests, in sector order. */
+	size_t req_cnt;             /* Number of requests. */
+};
+
+/* Picks the next request to serve from channel C's nonempty
+   queue, without removing it.  Called with C's lock held. */
+typedef struct disk_request *disk_pick_func (struct channel *c);
+
+/* A request scheduling policy. */
+struct disk_scheduler {
+	const char *name;           /* Name for the -ds option. */
+	disk_pick_func *pick;       /* Chooses the next request. */
+};
+
+static disk_pick_func pick_fifo, pick_clook, pick_deadline;
+
+static const struct disk_scheduler schedulers[] = {
+	{"fifo", pick_fifo},
+	{"clook", pick_clook},
+	{"deadline", pick_deadline},
+};
+#define SCHEDULER_CNT (sizeof schedulers / sizeof *schedulers)
+
+/* Policy in use. */
+static const struct disk_scheduler *scheduler = &schedulers[1];
+
+static void disk_worker (void *channel_);
+static void build_transfer (struct channel *, struct transfer *);
+static void do_transfer (struct transfer *);
+static void *transfer_sector (const struct transfer *, size_t idx);
+static void submit_and_wait (struct disk_request *);
+
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
+static void pio_transfer (const struct transfer *, size_t first, size_t cnt);
+
+static uint16_t find_bus_master (void);
+static bool dma_transfer (const struct transfer *, size_t first, size_t cnt);
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
@@ -96,11 +216,43 @@ static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
 
+/* TSC cycles per microsecond, for request latencies. */
+static uint64_t tsc_per_us;
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void) {
+	uint32_t lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/* Sets tsc_per_us by counting TSC cycles across one timer tick. */
+static void
+calibrate_tsc (void) {
+	int64_t start = timer_ticks ();
+	uint64_t tsc;
+
+	while (timer_ticks () == start)
+		continue;
+	start = timer_ticks ();
+	tsc = rdtsc ();
+	while (timer_ticks () == start)
+		continue;
+	tsc_per_us = (rdtsc () - tsc) / (1000000 / TIMER_FREQ);
+	if (tsc_per_us == 0)
+		tsc_per_us = 1;
+}
+
 /* Initialize the disk subsystem and detect disks. */
 void
 disk_init (void) {
+	uint16_t bm_base = find_bus_master ();
+	struct prd *prdt = bm_base != 0 ? palloc_get_page (0) : NULL;
 	size_t chan_no;
 
+	calibrate_tsc ();
+
 	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
 		struct channel *c = &channels[chan_no];
 		int dev_no;
@@ -119,10 +271,26 @@ disk_init (void) {
 			default:
 				NOT_REACHED ();
 		}
-		lock_init (&c->lock);
+		/* The secondary channel's bus master registers follow
+		   the primary's. */
+		if (prdt != NULL) {
+			c->bm_base = bm_base + chan_no * 8;
+			c->prdt = prdt + chan_no * PRDT_CNT;
+		} else {
+			c->bm_base = 0;
+			c->prdt = NULL;
+		}
 		c->expecting_interrupt = false;
 		sema_init (&c->completion_wait, 0);
 
+		lock_init (&c->lock);
+		cond_init (&c->queue_ready);
+		list_init (&c->queue);
+		c->head = 0;
+		c->depth = c->max_depth = 0;
+		c->depth_sum = c->submit_cnt = c->batch_cnt = 0;
+		c->merge_cnt = c->complete_cnt = 0;
+
 		/* Initialize devices. */
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = &c->devices[dev_no];
@@ -132,8 +300,11 @@ disk_init (void) {
 
 			d->is_ata = false;
 			d->capacity = 0;
+			d->use_dma = false;
+			d->multiple = 0;
 
-			d->read_cnt = d->write_cnt = 0;
+			d->read_cnt = d->write_cnt = d->dma_cnt = 0;
+			memset (&d->stats, 0, sizeof d->stats);
 		}
 
 		/* Register interrupt handler. */
@@ -150,12 +321,23 @@ disk_init (void) {
 		for (dev_no = 0; dev_no < 2; dev_no++)
 			if (c->devices[dev_no].is_ata)
 				identify_ata_device (&c->devices[dev_no]);
+
+		/* From here on the worker owns the controller. */
+		if (c->devices[0].is_ata || c->devices[1].is_ata)
+			thread_create (c->name, PRI_MAX, disk_worker, c);
 	}
 
 	/* DO NOT MODIFY BELOW LINES. */
 	register_disk_inspect_intr ();
 }
 
+/* Names of enum diskstat_op and enum diskstat_user members, for
+   disk_print_stats(). */
+static const char *const op_names[DISKSTAT_OP_CNT] = {"read", "write"};
+static const char *const user_names[DISKSTAT_USER_CNT] = {
+	"other", "swap", "fs metadata", "fs data", "page cache",
+};
+
 /* Prints disk statistics. */
 void
 disk_print_stats (void) {
@@ -166,11 +348,98 @@ disk_print_stats (void) {
 
 		for (dev_no = 0; dev_no < 2; dev_no++) {
 			struct disk *d = disk_get (chan_no, dev_no);
-			if (d != NULL && d->is_ata)
-				printf ("%s: %lld reads, %lld writes\n",
-						d->name, d->read_cnt, d->write_cnt);
+			struct diskstat st;
+			int op, user, i;
+
+			if (d == NULL || !d->is_ata)
+				continue;
+			printf ("%s: %lld reads, %lld writes, %lld by DMA\n",
+					d->name, d->read_cnt, d->write_cnt, d->dma_cnt);
+
+			disk_get_stats (d, &st);
+			for (op = 0; op < DISKSTAT_OP_CNT; op++) {
+				if (st.requests[op] == 0)
+					continue;
+				printf ("%s: %lld %s requests, latency avg %lld max %lld us:",
+						d->name, st.requests[op], op_names[op],
+						st.latency_sum[op] / st.requests[op], st.latency_max[op]);
+				for (i = 0; i < DISKSTAT_BUCKETS; i++)
+					if (st.latency_hist[op][i] != 0)
+						printf (" <%llu:%lld", 2ULL << i, st.latency_hist[op][i]);
+				printf ("\n");
+			}
+			for (user = 0; user < DISKSTAT_USER_CNT; user++)
+				if (st.user_sectors[user][DISKSTAT_READ] != 0
+						|| st.user_sectors[user][DISKSTAT_WRITE] != 0)
+					printf ("%s: %s: %lld sectors read, %lld written\n",
+							d->name, user_names[user],
+							st.user_sectors[user][DISKSTAT_READ],
+							st.user_sectors[user][DISKSTAT_WRITE]);
 		}
 	}
+
+	for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
+		struct channel *c = &channels[chan_no];
+		long long submits = c->submit_cnt > 0 ? c->submit_cnt : 1;
+
+		if (c->submit_cnt == 0)
+			continue;
+		printf ("%s: %s queue, %lld requests in %lld transfers "
+				"(%lld merged), depth avg %lld.%01lld max %zu\n",
+				c->name, scheduler->name, c->submit_cnt, c->batch_cnt,
+				c->merge_cnt, c->depth_sum / submits,
+				c->depth_sum * 10 / submits % 10, c->max_depth);
+	}
+}
+
+/* Copies disk D's statistics into *ST, leaving
+   ST->thread_sectors zeroed. */
+void
+disk_get_stats (struct disk *d, struct diskstat *st) {
+	struct channel *c = d->channel;
+
+	lock_acquire (&c->lock);
+	*st = d->stats;
+	lock_release (&c->lock);
+	memset (st->thread_sectors, 0, sizeof st->thread_sectors);
+}
+
+/* Attributes the disk I/O that the current thread issues from
+   now until the matching disk_user_end() to subsystem USER,
+   unless an enclosing call already attributed it elsewhere: the
+   file system reading on behalf of swap is still swap.  Returns
+   the value to pass to disk_user_end(). */
+enum diskstat_user
+disk_user_begin (enum diskstat_user user) {
+	struct thread *t = thread_current ();
+	enum diskstat_user old = t->disk_user;
+
+	if (old == DISKSTAT_OTHER)
+		t->disk_user = user;
+	return old;
+}
+
+/* Ends the attribution started by the disk_user_begin() call
+   that returned OLD. */
+void
+disk_user_end (enum diskstat_user old) {
+	thread_current ()->disk_user = old;
+}
+
+/* Selects the request scheduling policy named NAME: "fifo",
+   "clook" or "deadline".  Returns false if there is no such
+   policy.  Meant to be called while parsing the command line,
+   before any request is queued. */
+bool
+disk_set_scheduler (const char *name) {
+	size_t i;
+
+	for (i = 0; i < SCHEDULER_CNT; i++)
+		if (!strcmp (name, schedulers[i].name)) {
+			scheduler = &schedulers[i];
+			return true;
+		}
+	return false;
 }
 
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
@@ -209,21 +478,7 @@ disk_size (struct disk *d) {
    per-disk locking is unneeded. */
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
-	struct channel *c;
-
-	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
-
-	c = d->channel;
-	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-	input_sector (c, buffer);
-	d->read_cnt++;
-	lock_release (&c->lock);
+	disk_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -234,23 +489,387 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 /* buffer의 내용을 sec_no칸 disk d에 넣기*/
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
+	disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.  Up to CMD_SECTOR_MAX sectors move per disk command. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+		size_t cnt) {
+	struct disk_request r;
+
+	disk_request_init (&r, d, sec_no, buffer, cnt, false);
+	submit_and_wait (&r);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+		const void *buffer, size_t cnt) {
+	struct disk_request r;
+
+	disk_request_init (&r, d, sec_no, (void *) buffer, cnt, true);
+	submit_and_wait (&r);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D,
+   storing sector SEC_NO + i into BUFS[i], each of which must have
+   room for DISK_SECTOR_SIZE bytes. */
+void
+disk_readv (struct disk *d, disk_sector_t sec_no, void *const bufs[],
+		size_t cnt) {
+	struct disk_request r;
+
+	disk_request_initv (&r, d, sec_no, bufs, cnt, false);
+	submit_and_wait (&r);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D,
+   taking sector SEC_NO + i from BUFS[i], each of which must
+   contain DISK_SECTOR_SIZE bytes. */
+void
+disk_writev (struct disk *d, disk_sector_t sec_no, const void *const bufs[],
+		size_t cnt) {
+	struct disk_request r;
+
+	disk_request_initv (&r, d, sec_no, (void *const *) bufs, cnt, true);
+	submit_and_wait (&r);
+}
+
+/* Asynchronous requests. */
+
+/* Initializes R to read (if WRITE is false) or write CNT
+   consecutive sectors of disk D, starting at SEC_NO, from or to
+   BUFFER, which must be a kernel address with room for
+   CNT * DISK_SECTOR_SIZE bytes.  R gets normal priority, no
+   completion function, and the current thread's subsystem for
+   accounting; the caller may change any of them before passing
+   R to disk_submit(). */
+void
+disk_request_init (struct disk_request *r, struct disk *d,
+		disk_sector_t sec_no, void *buffer, size_t cnt, bool write) {
+	ASSERT (buffer != NULL);
+	ASSERT (is_kernel_vaddr (buffer));
+
+	r->buf = buffer;
+	r->bufs = &r->buf;
+	r->buf_size = cnt * DISK_SECTOR_SIZE;
+	r->disk = d;
+	r->sec_no = sec_no;
+	r->cnt = cnt;
+	r->write = write;
+	r->prio = DISK_PRIO_NORMAL;
+	r->user = thread_current ()->disk_user;
+	r->complete = NULL;
+	r->aux = NULL;
+	sema_init (&r->done, 0);
+}
+
+/* Initializes R like disk_request_init(), but for a
+   scatter-gather transfer of sector SEC_NO + i to or from
+   BUFS[i].  BUFS must stay valid until R completes. */
+void
+disk_request_initv (struct disk_request *r, struct disk *d,
+		disk_sector_t sec_no, void *const bufs[], size_t cnt, bool write) {
+	size_t i;
+
+	ASSERT (bufs != NULL);
+	for (i = 0; i < cnt; i++)
+		ASSERT (is_kernel_vaddr (bufs[i]));
+
+	r->buf = NULL;
+	r->bufs = bufs;
+	r->buf_size = DISK_SECTOR_SIZE;
+	r->disk = d;
+	r->sec_no = sec_no;
+	r->cnt = cnt;
+	r->write = write;
+	r->prio = DISK_PRIO_NORMAL;
+	r->user = thread_current ()->disk_user;
+	r->complete = NULL;
+	r->aux = NULL;
+	sema_init (&r->done, 0);
+}
+
+/* Queues R and returns without waiting for the disk.  When R
+   completes, its completion function is called from the
+   channel's worker thread if it has one; otherwise a thread
+   waiting in disk_wait() is woken.  R's memory must not be
+   reused until then. */
+void
+disk_submit (struct disk_request *r) {
+	struct disk *d = r->disk;
 	struct channel *c;
 
 	ASSERT (d != NULL);
-	ASSERT (buffer != NULL);
+	ASSERT (r->cnt > 0);
+	ASSERT (r->sec_no <= d->capacity && r->cnt <= d->capacity - r->sec_no);
+	ASSERT (r->prio >= 0 && r->prio < DISK_PRIO_CNT);
 
 	c = d->channel;
+	r->submit_time = timer_ticks ();
+	r->submit_tsc = rdtsc ();
+	r->deadline = r->submit_time + (r->write ? WRITE_DEADLINE : READ_DEADLINE);
+	thread_current ()->disk_sectors[r->write ? DISKSTAT_WRITE : DISKSTAT_READ]
+		+= r->cnt;
+
 	lock_acquire (&c->lock);
-	select_sector (d, sec_no);
-	issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-	if (!wait_while_busy (d))
-		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
-	d->write_cnt++;
+	list_push_back (&c->queue, &r->elem);
+	c->depth++;
+	if (c->depth > c->max_depth)
+		c->max_depth = c->depth;
+	c->depth_sum += c->depth;
+	c->submit_cnt++;
+	cond_signal (&c->queue_ready, &c->lock);
 	lock_release (&c->lock);
 }
 
+/* Waits for R, which must have been submitted without a
+   completion function, to complete. */
+void
+disk_wait (struct disk_request *r) {
+	ASSERT (r->complete == NULL);
+	sema_down (&r->done);
+}
+
+/* Submits R and waits for it. */
+static void
+submit_and_wait (struct disk_request *r) {
+	disk_submit (r);
+	disk_wait (r);
+}
+
+/* Returns the elevator sort key for R: disks in device order,
+   then sectors in ascending order. */
+static uint64_t
+request_key (const struct disk_request *r) {
+	return ((uint64_t) r->disk->dev_no << 32) | r->sec_no;
+}
+
+/* Returns the most urgent priority among the requests in C's
+   nonempty queue. */
+static enum disk_prio
+top_prio (struct channel *c) {
+	enum disk_prio prio = DISK_PRIO_CNT;
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (r->prio < prio)
+			prio = r->prio;
+	}
+	return prio;
+}
+
+/* First come, first served, within the most urgent priority. */
+static struct disk_request *
+pick_fifo (struct channel *c) {
+	enum disk_prio prio = top_prio (c);
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (r->prio == prio)
+			return r;
+	}
+	NOT_REACHED ();
+}
+
+/* C-LOOK elevator, within the most urgent priority: the request
+   at or after the head position with the lowest sector, or the
+   lowest sector overall once nothing lies ahead of the head. */
+static struct disk_request *
+pick_clook (struct channel *c) {
+	enum disk_prio prio = top_prio (c);
+	struct disk_request *ahead = NULL, *lowest = NULL;
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		uint64_t key = request_key (r);
+
+		if (r->prio != prio)
+			continue;
+		if (key >= c->head && (ahead == NULL || key < request_key (ahead)))
+			ahead = r;
+		if (lowest == NULL || key < request_key (lowest))
+			lowest = r;
+	}
+	return ahead != NULL ? ahead : lowest;
+}
+
+/* C-LOOK, except that a request of any priority whose deadline
+   has passed goes first, so that low-priority writeback cannot
+   starve. */
+static struct disk_request *
+pick_deadline (struct channel *c) {
+	struct disk_request *oldest = NULL;
+	struct list_elem *e;
+
+	for (e = list_begin (&c->queue); e != list_end (&c->queue);
+			e = list_next (e)) {
+		struct disk_request *r = list_entry (e, struct disk_request, elem);
+		if (oldest == NULL || r->deadline < oldest->deadline)
+			oldest = r;
+	}
+	if (oldest->deadline <= timer_ticks ())
+		return oldest;
+	return pick_clook (c);
+}
+
+/* Removes the next request chosen by the scheduler from C's
+   nonempty queue into T, along with any queued requests for the
+   sectors immediately before or after it on the same disk in the
+   same direction, up to one disk command's worth.  Called with
+   C's lock held. */
+static void
+build_transfer (struct channel *c, struct transfer *t) {
+	struct disk_request *r = scheduler->pick (c);
+	bool merged;
+
+	list_remove (&r->elem);
+	t->disk = r->disk;
+	t->sec_no = r->sec_no;
+	t->cnt = r->cnt;
+	t->write = r->write;
+	t->reqs[0] = r;
+	t->req_cnt = 1;
+
+	do {
+		struct list_elem *e;
+
+		merged = false;
+		for (e = list_begin (&c->queue);
+				e != list_end (&c->queue) && t->req_cnt < BATCH_MAX;
+				e = list_next (e)) {
+			struct disk_request *m = list_entry (e, struct disk_request, elem);
+
+			if (m->disk != t->disk || m->write != t->write
+					|| t->cnt + m->cnt > CMD_SECTOR_MAX)
+				continue;
+			if (m->sec_no == t->sec_no + t->cnt)
+				t->reqs[t->req_cnt] = m;
+			else if (m->sec_no + m->cnt == t->sec_no) {
+				memmove (t->reqs + 1, t->reqs, t->req_cnt * sizeof *t->reqs);
+				t->reqs[0] = m;
+				t->sec_no = m->sec_no;
+			} else
+				continue;
+
+			list_remove (&m->elem);
+			t->req_cnt++;
+			t->cnt += m->cnt;
+			c->merge_cnt++;
+			merged = true;
+			break;
+		}
+	} while (merged);
+
+	c->depth -= t->req_cnt;
+	c->batch_cnt++;
+	c->head = ((uint64_t) t->disk->dev_no << 32) | (t->sec_no + t->cnt);
+}
+
+/* Adds request R, completed at TSC time NOW, to its disk's
+   statistics.  Called with the channel lock held. */
+static void
+account_request (const struct disk_request *r, uint64_t now) {
+	struct diskstat *st = &r->disk->stats;
+	int op = r->write ? DISKSTAT_WRITE : DISKSTAT_READ;
+	long long us = (now - r->submit_tsc) / tsc_per_us;
+	int bucket = 63 - __builtin_clzll ((unsigned long long) us | 1);
+
+	if (bucket >= DISKSTAT_BUCKETS)
+		bucket = DISKSTAT_BUCKETS - 1;
+	st->requests[op]++;
+	st->sectors[op] += r->cnt;
+	st->latency_sum[op] += us;
+	if (us > st->latency_max[op])
+		st->latency_max[op] = us;
+	st->latency_hist[op][bucket]++;
+	st->user_sectors[r->user][op] += r->cnt;
+}
+
+/* Worker thread for channel C_.  Takes transfers off the
+   channel's queue one at a time, moves them, and completes
+   their requests. */
+static void
+disk_worker (void *c_) {
+	struct channel *c = c_;
+
+	for (;;) {
+		struct transfer t;
+		uint64_t now;
+		size_t i;
+
+		lock_acquire (&c->lock);
+		while (list_empty (&c->queue))
+			cond_wait (&c->queue_ready, &c->lock);
+		build_transfer (c, &t);
+		lock_release (&c->lock);
+
+		do_transfer (&t);
+
+		now = rdtsc ();
+		lock_acquire (&c->lock);
+		for (i = 0; i < t.req_cnt; i++)
+			account_request (t.reqs[i], now);
+		c->complete_cnt += t.req_cnt;
+		lock_release (&c->lock);
+
+		/* A request may be freed as soon as it completes, so
+		   touch nothing in it afterward. */
+		for (i = 0; i < t.req_cnt; i++) {
+			struct disk_request *r = t.reqs[i];
+			if (r->complete != NULL)
+				r->complete (r, r->aux);
+			else
+				sema_up (&r->done);
+		}
+	}
+}
+
+/* Moves T, one disk command of at most CMD_SECTOR_MAX sectors at
+   a time.  Called only by the channel's worker thread. */
+static void
+do_transfer (struct transfer *t) {
+	struct disk *d = t->disk;
+	size_t first;
+
+	for (first = 0; first < t->cnt; first += CMD_SECTOR_MAX) {
+		size_t cnt = t->cnt - first;
+		if (cnt > CMD_SECTOR_MAX)
+			cnt = CMD_SECTOR_MAX;
+
+		if (!dma_transfer (t, first, cnt))
+			pio_transfer (t, first, cnt);
+		if (t->write)
+			d->write_cnt += cnt;
+		else
+			d->read_cnt += cnt;
+	}
+}
+
+/* Returns the memory for sector IDX, counting from 0, of T. */
+static void *
+transfer_sector (const struct transfer *t, size_t idx) {
+	const struct disk_request *r;
+	size_t i, ofs;
+
+	for (i = 0; idx >= t->reqs[i]->cnt; i++)
+		idx -= t->reqs[i]->cnt;
+	r = t->reqs[i];
+	ofs = idx * DISK_SECTOR_SIZE;
+	return (uint8_t *) r->bufs[ofs / r->buf_size] + ofs % r->buf_size;
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -365,6 +984,21 @@ identify_ata_device (struct disk *d) {
 	/* Calculate capacity. */
 	d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+	/* Word 49 bit 8 says whether the disk can do DMA at all. */
+	d->use_dma = c->bm_base != 0 && (id[49] & (1 << 8)) != 0;
+
+	/* Word 47 holds the largest block READ/WRITE MULTIPLE can
+	   move per interrupt.  Ask for that block size. */
+	if ((id[47] & 0xff) != 0) {
+		select_device_wait (d);
+		outb (reg_nsect (c), id[47] & 0xff);
+		issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+		sema_down (&c->completion_wait);
+		wait_while_busy (d);
+		if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+			d->multiple = id[47] & 0xff;
+	}
+
 	/* Print identification message. */
 	printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
 	if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -403,17 +1037,18 @@ print_ata_string (char *string, size_t size) {
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the count CNT of sectors to transfer to the
+   disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) {
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
 	ASSERT (sec_no < d->capacity);
 	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt >= 1 && cnt <= CMD_SECTOR_MAX);
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
@@ -447,6 +1082,195 @@ output_sector (struct channel *c, const void *sector) {
 	outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
 }
 
+/* Moves CNT sectors of T, starting at its sector FIRST, with a
+   single PIO command.  The disk interrupts once per block of
+   `multiple' sectors if it supports READ/WRITE MULTIPLE and once
+   per sector otherwise.  Called only by the channel's worker
+   thread. */
+static void
+pio_transfer (const struct transfer *t, size_t first, size_t cnt) {
+	struct disk *d = t->disk;
+	struct channel *c = d->channel;
+	disk_sector_t sec_no = t->sec_no + first;
+	size_t block = d->multiple != 0 ? d->multiple : 1;
+	uint8_t command;
+	size_t i;
+
+	if (t->write)
+		command = d->multiple != 0 ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY;
+	else
+		command = d->multiple != 0 ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY;
+
+	select_sector (d, sec_no, cnt);
+	issue_pio_command (c, command);
+	for (i = 0; i < cnt; i += block) {
+		size_t end = i + block < cnt ? i + block : cnt;
+		size_t j;
+
+		if (!t->write)
+			sema_down (&c->completion_wait);
+		if (!wait_while_busy (d))
+			PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+					t->write ? "write" : "read", sec_no + (disk_sector_t) i);
+		for (j = i; j < end; j++) {
+			if (t->write)
+				output_sector (c, transfer_sector (t, first + j));
+			else
+				input_sector (c, transfer_sector (t, first + j));
+		}
+		if (t->write)
+			sema_down (&c->completion_wait);
+	}
+}
+
+/* Bus master DMA. */
+
+/* Reads and returns the 32-bit register at byte offset REG of the
+   configuration space of PCI bus 0, device DEV, function FUNC. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) {
+	outl (0xcf8, 0x80000000 | (dev << 11) | (func << 8) | (reg & 0xfc));
+	return inl (0xcfc);
+}
+
+/* Writes VALUE to the 32-bit register at byte offset REG of the
+   configuration space of PCI bus 0, device DEV, function FUNC. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) {
+	outl (0xcf8, 0x80000000 | (dev << 11) | (func << 8) | (reg & 0xfc));
+	outl (0xcfc, value);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that drives the legacy
+   channels and can act as a bus master, such as the PIIX in a
+   standard PC.  If one is found, enables bus mastering on it and
+   returns the I/O port of its primary channel's bus master
+   registers.  Otherwise returns 0, and all transfers use PIO. */
+static uint16_t
+find_bus_master (void) {
+	int dev, func;
+
+	for (dev = 0; dev < 32; dev++)
+		for (func = 0; func < 8; func++) {
+			uint32_t id = pci_read_config (dev, func, 0x00);
+			uint32_t class = pci_read_config (dev, func, 0x08);
+			uint32_t bar4, command;
+
+			if ((id & 0xffff) == 0xffff)
+				continue;
+
+			/* Mass storage (0x01), IDE (0x01), with both channels
+			   in compatibility mode (prog-if bits 0 and 2 clear)
+			   and bus master capable (prog-if bit 7). */
+			if ((class >> 16) != 0x0101 || (class & 0x8500) != 0x8000)
+				continue;
+
+			bar4 = pci_read_config (dev, func, 0x20);
+			if ((bar4 & 1) == 0 || (bar4 & 0xfffc) == 0)
+				continue;
+
+			/* Enable I/O space and bus mastering. */
+			command = pci_read_config (dev, func, 0x04);
+			pci_write_config (dev, func, 0x04, command | 0x05);
+			return bar4 & 0xfffc;
+		}
+	return 0;
+}
+
+/* Fills the PRD table of T's channel to describe CNT sectors of
+   T, starting at its sector FIRST.  Sectors that are physically
+   adjacent share a descriptor.  Returns false if some sector
+   cannot be reached by the bus master or the table would
+   overflow, in which case the caller must use PIO. */
+static bool
+prepare_prdt (const struct transfer *t, size_t first, size_t cnt) {
+	struct prd *prdt = t->disk->channel->prdt;
+	size_t prd_cnt = 0;
+	size_t last_size = 0;
+	size_t i;
+
+	for (i = first; i < first + cnt; i++) {
+		const uint8_t *p = transfer_sector (t, i);
+		size_t left = DISK_SECTOR_SIZE;
+
+		if (!is_kernel_vaddr (p) || ((uintptr_t) p & 1) != 0)
+			return false;
+
+		while (left > 0) {
+			uint64_t phys = vtop (p);
+			size_t chunk = 0x10000 - (phys & 0xffff);
+
+			if (chunk > left)
+				chunk = left;
+			if (phys + chunk > 0x100000000ULL)
+				return false;
+
+			if (prd_cnt > 0
+					&& prdt[prd_cnt - 1].addr + last_size == phys
+					&& (phys & 0xffff) != 0)
+				last_size += chunk;
+			else {
+				if (prd_cnt == PRDT_CNT)
+					return false;
+				prdt[prd_cnt].addr = phys;
+				prdt[prd_cnt].flags = 0;
+				prd_cnt++;
+				last_size = chunk;
+			}
+			prdt[prd_cnt - 1].size = last_size & 0xffff;
+			p += chunk;
+			left -= chunk;
+		}
+	}
+	prdt[prd_cnt - 1].flags = PRD_EOT;
+	return true;
+}
+
+/* Moves CNT sectors of T, starting at its sector FIRST, with one
+   bus master DMA command.  The CPU sleeps on the completion
+   interrupt for the whole transfer instead of copying the data
+   itself.
+
+   Returns false without touching the disk if the disk or T's
+   memory is unsuitable for DMA.  Also returns false if the
+   transfer fails, after turning DMA off for the disk, so that the
+   caller's PIO retry and every later request go the old way.
+
+   Called only by the channel's worker thread. */
+static bool
+dma_transfer (const struct transfer *t, size_t first, size_t cnt) {
+	struct disk *d = t->disk;
+	struct channel *c = d->channel;
+	disk_sector_t sec_no = t->sec_no + first;
+	uint8_t bm_status, status;
+
+	if (!d->use_dma || !prepare_prdt (t, first, cnt))
+		return false;
+
+	outb (reg_bm_command (c), 0);
+	outl (reg_bm_prdt (c), vtop (c->prdt));
+	outb (reg_bm_status (c),
+			inb (reg_bm_status (c)) | BM_STA_ERROR | BM_STA_INTR);
+
+	select_sector (d, sec_no, cnt);
+	issue_pio_command (c, t->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+	outb (reg_bm_command (c), BM_CMD_START | (t->write ? 0 : BM_CMD_READ));
+	sema_down (&c->completion_wait);
+
+	outb (reg_bm_command (c), 0);
+	bm_status = inb (reg_bm_status (c));
+	outb (reg_bm_status (c), bm_status | BM_STA_ERROR | BM_STA_INTR);
+	status = inb (reg_alt_status (c));
+	if ((bm_status & BM_STA_ERROR) != 0 || (status & STA_ERR) != 0) {
+		printf ("%s: DMA %s failed, sector=%"PRDSNu", using PIO\n",
+				d->name, t->write ? "write" : "read", sec_no);
+		d->use_dma = false;
+		return false;
+	}
+	d->dma_cnt += cnt;
+	return true;
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -0,0 +1,408 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in the cache. */
+#define CACHE_CNT 64
+
+/* Timer ticks between write-backs of dirty sectors. */
+#define FLUSH_TICKS TIMER_FREQ
+
+/* Most sectors written back in one request. */
+#define FLUSH_RUN 16
+
+/* A cache slot. */
+struct cache_entry {
+	struct hash_elem elem;              /* Element in `cache'. */
+	disk_sector_t sector;               /* Sector held, if in use. */
+	bool in_use;                        /* Holds or is loading `sector'? */
+	bool loading;                       /* Read from disk in flight? */
+	bool writing;                       /* Write-back in flight? */
+	bool dirty;                         /* Newer than the disk? */
+	bool accessed;                      /* Used since the clock hand passed? */
+	int pins;                           /* Threads using data. */
+	struct condition idle;              /* Signaled when `loading' or
+	                                       `writing' clears. */
+	struct disk_request req;            /* Readahead request. */
+	uint8_t *data;                      /* DISK_SECTOR_SIZE bytes. */
+};
+
+/* Cache of file data sectors.  Writes into cached sectors only
+ * mark them dirty, and a background thread writes dirty sectors
+ * back every FLUSH_TICKS, so that small writes to one sector
+ * reach the disk together.  Dirty sectors are never evicted.
+ * Callers must only write sectors that are not cached straight
+ * to disk, so that a write-back never overtakes newer data.
+ *
+ * cache_lock protects the table and every entry's bookkeeping.
+ * Data is copied in and out without it, while the entry is
+ * pinned so that it cannot be evicted; callers hold the owning
+ * inode's lock, which keeps readers and writers of a sector
+ * apart. */
+static struct cache_entry entries[CACHE_CNT];
+static struct hash cache;               /* Entries in use, by sector. */
+static struct lock cache_lock;
+static size_t clock_hand;               /* Next entry to consider evicting. */
+
+static uint64_t entry_hash (const struct hash_elem *, void *);
+static bool entry_less (const struct hash_elem *, const struct hash_elem *,
+		void *);
+static void prefetch_done (struct disk_request *, void *);
+static void flush_daemon (void *);
+
+/* Initializes the buffer cache. */
+void
+cache_init (void) {
+	uint8_t *data;
+	size_t i;
+
+	data = palloc_get_multiple (PAL_ASSERT,
+			CACHE_CNT * DISK_SECTOR_SIZE / PGSIZE);
+	if (!hash_init (&cache, entry_hash, entry_less, NULL))
+		PANIC ("buffer cache creation failed");
+	lock_init (&cache_lock);
+	for (i = 0; i < CACHE_CNT; i++) {
+		struct cache_entry *e = &entries[i];
+		e->in_use = false;
+		e->loading = false;
+		e->writing = false;
+		e->dirty = false;
+		e->accessed = false;
+		e->pins = 0;
+		cond_init (&e->idle);
+		e->data = data + i * DISK_SECTOR_SIZE;
+	}
+	thread_create ("flushd", PRI_DEFAULT, flush_daemon, NULL);
+}
+
+/* Returns a hash value for the cache entry that contains E. */
+static uint64_t
+entry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct cache_entry, elem)->sector);
+}
+
+/* Returns true if the entry that contains A comes before the one
+ * that contains B. */
+static bool
+entry_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct cache_entry, elem)->sector
+		< hash_entry (b, struct cache_entry, elem)->sector;
+}
+
+/* Returns the entry holding SECTOR, or a null pointer.
+ * The caller must hold cache_lock. */
+static struct cache_entry *
+find (disk_sector_t sector) {
+	struct cache_entry key;
+	struct hash_elem *e;
+
+	key.sector = sector;
+	e = hash_find (&cache, &key.elem);
+	return e != NULL ? hash_entry (e, struct cache_entry, elem) : NULL;
+}
+
+/* Takes an entry for SECTOR, evicting the least recently used
+ * idle, clean entry with the clock algorithm, and marks it
+ * loading.  Returns a null pointer if every entry is busy or
+ * dirty.  The caller must hold cache_lock and must load the
+ * entry. */
+static struct cache_entry *
+claim (disk_sector_t sector) {
+	struct cache_entry *e = NULL;
+	size_t i;
+
+	for (i = 0; i < 2 * CACHE_CNT; i++) {
+		struct cache_entry *c = &entries[clock_hand];
+		clock_hand = (clock_hand + 1) % CACHE_CNT;
+		if (!c->in_use) {
+			e = c;
+			break;
+		}
+		if (c->loading || c->dirty || c->pins > 0)
+			continue;
+		if (c->accessed)
+			c->accessed = false;
+		else {
+			hash_delete (&cache, &c->elem);
+			e = c;
+			break;
+		}
+	}
+	if (e == NULL)
+		return NULL;
+
+	e->sector = sector;
+	e->in_use = true;
+	e->loading = true;
+	e->accessed = true;
+	hash_insert (&cache, &e->elem);
+	return e;
+}
+
+/* Waits until E, which the caller has pinned, is loaded.
+ * The caller must hold cache_lock. */
+static void
+wait_loaded (struct cache_entry *e) {
+	ASSERT (e->pins > 0);
+	while (e->loading)
+		cond_wait (&e->idle, &cache_lock);
+}
+
+/* Marks E loaded and wakes up its waiters.
+ * The caller must hold cache_lock. */
+static void
+finish_load (struct cache_entry *e) {
+	e->loading = false;
+	cond_broadcast (&e->idle, &cache_lock);
+}
+
+/* Writes dirty entry E back to disk, along with the dirty entries
+ * for up to FLUSH_RUN - 1 sectors that follow it, in a single
+ * request.  Data written into the entries meanwhile marks them
+ * dirty again.  The caller must hold cache_lock, which is
+ * released during the write. */
+static void
+write_back (struct cache_entry *e) {
+	struct cache_entry *run[FLUSH_RUN];
+	void *bufs[FLUSH_RUN];
+	size_t cnt, i;
+
+	ASSERT (e->dirty && !e->loading && !e->writing);
+
+	for (cnt = 0; cnt < FLUSH_RUN; cnt++) {
+		struct cache_entry *c = cnt == 0 ? e : find (e->sector + cnt);
+		if (c == NULL || !c->dirty || c->loading || c->writing)
+			break;
+		c->dirty = false;
+		c->writing = true;
+		c->pins++;
+		run[cnt] = c;
+		bufs[cnt] = c->data;
+	}
+	lock_release (&cache_lock);
+
+	disk_writev (filesys_disk, e->sector, (const void *const *) bufs, cnt);
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < cnt; i++) {
+		run[i]->writing = false;
+		run[i]->pins--;
+		cond_broadcast (&run[i]->idle, &cache_lock);
+	}
+}
+
+/* Copies SIZE bytes at offset OFS within SECTOR into BUFFER from
+ * the cache.  If SECTOR is not cached and FILL is true, reads it
+ * into the cache first.
+ * Returns true if successful, false if SECTOR is not cached and
+ * either FILL is false or every entry is busy. */
+bool
+cache_read (disk_sector_t sector, void *buffer, int ofs, int size,
+		bool fill) {
+	struct cache_entry *e;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	e = find (sector);
+	if (e != NULL) {
+		e->pins++;
+		wait_loaded (e);
+	} else {
+		if (!fill || (e = claim (sector)) == NULL) {
+			lock_release (&cache_lock);
+			return false;
+		}
+		e->pins++;
+		lock_release (&cache_lock);
+		disk_read (filesys_disk, sector, e->data);
+		lock_acquire (&cache_lock);
+		finish_load (e);
+	}
+	e->accessed = true;
+	lock_release (&cache_lock);
+
+	memcpy (buffer, e->data + ofs, size);
+
+	lock_acquire (&cache_lock);
+	e->pins--;
+	lock_release (&cache_lock);
+	return true;
+}
+
+/* Copies SIZE bytes from BUFFER to offset OFS within SECTOR in
+ * the cache and marks it to be written back later.  If SECTOR is
+ * not cached, it is first read from disk, or if ZERO is true
+ * started as all zeros; if ZERO is true, bytes outside the copied
+ * range are zeroed even when SECTOR is cached.
+ * Returns true if successful, false if SECTOR is not cached and
+ * every entry is busy or dirty, in which case the caller must
+ * write to disk itself. */
+bool
+cache_write (disk_sector_t sector, const void *buffer, int ofs, int size,
+		bool zero) {
+	struct cache_entry *e;
+
+	ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+	lock_acquire (&cache_lock);
+	e = find (sector);
+	if (e != NULL) {
+		/* A readahead still in flight could overwrite the copy
+		 * with older data. */
+		e->pins++;
+		wait_loaded (e);
+	} else {
+		e = claim (sector);
+		if (e == NULL) {
+			lock_release (&cache_lock);
+			return false;
+		}
+		e->pins++;
+		if (!zero && size < DISK_SECTOR_SIZE) {
+			lock_release (&cache_lock);
+			disk_read (filesys_disk, sector, e->data);
+			lock_acquire (&cache_lock);
+		}
+		finish_load (e);
+	}
+	e->accessed = true;
+	lock_release (&cache_lock);
+
+	if (zero) {
+		memset (e->data, 0, ofs);
+		memset (e->data + ofs + size, 0, DISK_SECTOR_SIZE - ofs - size);
+	}
+	memcpy (e->data + ofs, buffer, size);
+
+	/* Marked only now, so that a write-back that raced with the
+	 * copy is followed by another. */
+	lock_acquire (&cache_lock);
+	e->dirty = true;
+	e->pins--;
+	lock_release (&cache_lock);
+	return true;
+}
+
+/* Returns true if SECTOR is in the cache. */
+bool
+cache_contains (disk_sector_t sector) {
+	bool found;
+
+	lock_acquire (&cache_lock);
+	found = find (sector) != NULL;
+	lock_release (&cache_lock);
+	return found;
+}
+
+/* Returns how many of the CNT sectors starting at SECTOR come
+ * before the first one after SECTOR that is cached.  SECTOR
+ * itself is assumed absent, so the result is at least 1 if CNT
+ * is nonzero. */
+size_t
+cache_absent_run (disk_sector_t sector, size_t cnt) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 1; i < cnt; i++)
+		if (find (sector + i) != NULL)
+			break;
+	lock_release (&cache_lock);
+	return cnt > 0 ? i : 0;
+}
+
+/* Starts reading SECTOR into the cache, if it is not there
+ * already, without waiting for the read to finish.  Does nothing
+ * if every entry is busy. */
+void
+cache_prefetch (disk_sector_t sector) {
+	struct cache_entry *e;
+
+	lock_acquire (&cache_lock);
+	e = find (sector) == NULL ? claim (sector) : NULL;
+	lock_release (&cache_lock);
+	if (e == NULL)
+		return;
+
+	disk_request_init (&e->req, filesys_disk, sector, e->data, 1, false);
+	e->req.complete = prefetch_done;
+	e->req.aux = e;
+	disk_submit (&e->req);
+}
+
+/* Completion function for cache_prefetch() requests.  Runs in the
+ * disk's worker thread. */
+static void
+prefetch_done (struct disk_request *r UNUSED, void *e) {
+	lock_acquire (&cache_lock);
+	finish_load (e);
+	lock_release (&cache_lock);
+}
+
+/* Writes back the dirty cached sectors among the CNT sectors
+ * starting at SECTOR, and waits for write-backs of them that are
+ * already in flight, so that all of them are on disk on return. */
+void
+cache_flush (disk_sector_t sector, size_t cnt) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < CACHE_CNT; i++) {
+		struct cache_entry *e = &entries[i];
+		if (!e->in_use || e->sector < sector || e->sector - sector >= cnt)
+			continue;
+		e->pins++;
+		while (e->writing)
+			cond_wait (&e->idle, &cache_lock);
+		if (e->dirty && !e->loading)
+			write_back (e);
+		e->pins--;
+	}
+	lock_release (&cache_lock);
+}
+
+/* Writes back every dirty sector in the cache. */
+void
+cache_flush_all (void) {
+	cache_flush (0, (size_t) -1);
+}
+
+/* Forgets any dirty data for the CNT sectors starting at SECTOR,
+ * which are being freed, so that a later write-back cannot land
+ * on whatever they are reused for. */
+void
+cache_discard (disk_sector_t sector, size_t cnt) {
+	size_t i;
+
+	lock_acquire (&cache_lock);
+	for (i = 0; i < CACHE_CNT; i++) {
+		struct cache_entry *e = &entries[i];
+		if (!e->in_use || e->sector < sector || e->sector - sector >= cnt)
+			continue;
+		e->pins++;
+		while (e->writing)
+			cond_wait (&e->idle, &cache_lock);
+		e->dirty = false;
+		e->pins--;
+	}
+	lock_release (&cache_lock);
+}
+
+/* Writes back dirty sectors every FLUSH_TICKS.  Runs as a kernel
+ * thread for as long as the file system is up. */
+static void
+flush_daemon (void *aux UNUSED) {
+	disk_user_begin (DISKSTAT_FS_DATA);
+	for (;;) {
+		timer_sleep (FLUSH_TICKS);
+		cache_flush_all ();
+	}
+}
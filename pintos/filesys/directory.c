@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "devices/disk.h"
 
 /* A directory. */
 struct dir {
@@ -19,11 +22,180 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Directories start out as an unordered array of entries, which
+ * is searched linearly.  A directory that would grow past
+ * DIR_LINEAR_MAX entries is rebuilt as an open-addressing hash
+ * table instead: entry 0 becomes a header whose inode_sector is
+ * DIR_HASHED_MAGIC, and every other entry lives at or after slot
+ * 1 + hash (name) % (slots - 1), probing linearly.  A free entry
+ * with inode_sector 0 has never been used and ends a probe; a
+ * removed entry keeps its inode_sector and does not. */
+#define DIR_LINEAR_MAX 64
+#define DIR_HASHED_MAGIC 0xd1d1d1d1
+
+/* An insertion that probes this many slots without finding a
+ * free one rebuilds the table at twice the size. */
+#define DIR_PROBE_MAX 16
+
+/* Serializes changes to directory contents against lookups.
+ * Each inode's own lock makes single entry reads and writes
+ * atomic, but dir_add() and dir_remove() look an entry up and
+ * then write it, which must not interleave with another change.
+ * There is only one directory, so one lock suffices. */
+static struct rwlock dir_lock;
+
+/* Number of entries in the dentry cache. */
+#define DCACHE_CNT 128
+
+/* A cached answer to "which inode does NAME in the directory at
+ * sector PARENT name?", which may be "none". */
+struct dentry {
+	struct hash_elem hash_elem;         /* Element in dcache. */
+	struct list_elem lru_elem;          /* Element in dcache_lru. */
+	disk_sector_t parent;               /* Directory's inode sector. */
+	char name[NAME_MAX + 1];            /* Null terminated file name,
+	                                       empty if unused. */
+	bool negative;                      /* True if NAME does not exist. */
+	disk_sector_t inode_sector;         /* Otherwise, its inode. */
+};
+
+/* Dentry cache, so that repeated lookups of the same names do not
+ * read directory contents.  Entries are recycled least recently
+ * used first.  Lookups update the LRU order while holding dir_lock
+ * only for reading, so the cache has a lock of its own. */
+static struct dentry dentries[DCACHE_CNT];
+static struct hash dcache;
+static struct list dcache_lru;          /* Most recently used first. */
+static struct lock dcache_lock;
+
+static uint64_t dentry_hash (const struct hash_elem *, void *);
+static bool dentry_less (const struct hash_elem *, const struct hash_elem *,
+		void *);
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	size_t i;
+
+	rwlock_init (&dir_lock);
+	if (!hash_init (&dcache, dentry_hash, dentry_less, NULL))
+		PANIC ("dentry cache creation failed");
+	list_init (&dcache_lru);
+	lock_init (&dcache_lock);
+	for (i = 0; i < DCACHE_CNT; i++) {
+		dentries[i].name[0] = '\0';
+		list_push_back (&dcache_lru, &dentries[i].lru_elem);
+	}
+}
+
+/* Returns a hash value for the dentry that contains E. */
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+/* Returns true if the dentry that contains A comes before the
+ * one that contains B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the cached dentry for NAME in the directory at sector
+ * PARENT, or a null pointer.  The caller must hold dcache_lock. */
+static struct dentry *
+dcache_find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dcache, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Looks up NAME in the directory at sector PARENT in the dentry
+ * cache.  Returns true if there is an answer, setting *NEGATIVE
+ * and, if NAME exists, *SECTORP. */
+static bool
+dcache_lookup (disk_sector_t parent, const char *name, bool *negative,
+		disk_sector_t *sectorp) {
+	struct dentry *d;
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (parent, name);
+	if (d != NULL) {
+		list_remove (&d->lru_elem);
+		list_push_front (&dcache_lru, &d->lru_elem);
+		*negative = d->negative;
+		*sectorp = d->inode_sector;
+	}
+	lock_release (&dcache_lock);
+	return d != NULL;
+}
+
+/* Records in the dentry cache that NAME in the directory at
+ * sector PARENT names the inode at SECTOR, or nothing if
+ * NEGATIVE. */
+static void
+dcache_insert (disk_sector_t parent, const char *name, bool negative,
+		disk_sector_t sector) {
+	struct dentry *d;
+
+	ASSERT (*name != '\0');
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (parent, name);
+	if (d == NULL) {
+		/* Recycle the least recently used entry. */
+		d = list_entry (list_back (&dcache_lru), struct dentry, lru_elem);
+		if (d->name[0] != '\0')
+			hash_delete (&dcache, &d->hash_elem);
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dcache, &d->hash_elem);
+	}
+	d->negative = negative;
+	d->inode_sector = sector;
+	list_remove (&d->lru_elem);
+	list_push_front (&dcache_lru, &d->lru_elem);
+	lock_release (&dcache_lock);
+}
+
+/* Drops every dentry cached for the directory at sector PARENT,
+ * which is being created anew. */
+static void
+dcache_invalidate_dir (disk_sector_t parent) {
+	size_t i;
+
+	lock_acquire (&dcache_lock);
+	for (i = 0; i < DCACHE_CNT; i++) {
+		struct dentry *d = &dentries[i];
+		if (d->name[0] != '\0' && d->parent == parent) {
+			hash_delete (&dcache, &d->hash_elem);
+			d->name[0] = '\0';
+			list_remove (&d->lru_elem);
+			list_push_back (&dcache_lru, &d->lru_elem);
+		}
+	}
+	lock_release (&dcache_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+	bool success = inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+	disk_user_end (old_user);
+	dcache_invalidate_dir (sector);
+	return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -71,6 +243,42 @@ dir_get_inode (struct dir *dir) {
 	return dir->inode;
 }
 
+/* Returns the number of entry slots in DIR. */
+static size_t
+dir_slots (const struct dir *dir) {
+	return inode_length (dir->inode) / sizeof (struct dir_entry);
+}
+
+/* Reads slot IDX of DIR into *E.
+ * Returns true if successful, false at end of file. */
+static bool
+read_slot (const struct dir *dir, size_t idx, struct dir_entry *e) {
+	return inode_read_at (dir->inode, e, sizeof *e, idx * sizeof *e)
+		== sizeof *e;
+}
+
+/* Returns true if DIR is in the hashed format. */
+static bool
+is_hashed (const struct dir *dir) {
+	struct dir_entry e;
+	return (read_slot (dir, 0, &e) && !e.in_use
+			&& e.inode_sector == DIR_HASHED_MAGIC);
+}
+
+/* Returns the first slot to probe for NAME in a hashed directory
+ * with SLOTS slots, counting the header. */
+static size_t
+home_slot (const char *name, size_t slots) {
+	return 1 + hash_string (name) % (slots - 1);
+}
+
+/* Returns the slot after IDX in the probe sequence of a hashed
+ * directory with SLOTS slots. */
+static size_t
+next_slot (size_t idx, size_t slots) {
+	return idx + 1 < slots ? idx + 1 : 1;
+}
+
 /* Searches DIR for a file with the given NAME.
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
@@ -80,20 +288,110 @@ static bool
 lookup (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
 	struct dir_entry e;
-	size_t ofs;
+	size_t idx, i;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (e.in_use && !strcmp (name, e.name)) {
-			if (ep != NULL)
-				*ep = e;
-			if (ofsp != NULL)
-				*ofsp = ofs;
-			return true;
+	if (is_hashed (dir)) {
+		size_t slots = dir_slots (dir);
+
+		for (i = 1, idx = home_slot (name, slots); i < slots;
+				i++, idx = next_slot (idx, slots)) {
+			if (!read_slot (dir, idx, &e)
+					|| (!e.in_use && e.inode_sector == 0))
+				return false;
+			if (e.in_use && !strcmp (name, e.name))
+				goto found;
 		}
+		return false;
+	}
+
+	for (idx = 0; read_slot (dir, idx, &e); idx++)
+		if (e.in_use && !strcmp (name, e.name))
+			goto found;
+	return false;
+
+found:
+	if (ep != NULL)
+		*ep = e;
+	if (ofsp != NULL)
+		*ofsp = idx * sizeof e;
+	return true;
+}
+
+/* Rewrites DIR in the hashed format, with all of its entries plus
+ * NEW, in a table with room for twice as many.  The table never
+ * shrinks, because files cannot.
+ * Returns true if successful, false on failure. */
+static bool
+rehash (struct dir *dir, const struct dir_entry *new) {
+	size_t old_slots = dir_slots (dir);
+	size_t live = 0, slots, i;
+	struct dir_entry *old, *table = NULL;
+	bool success = false;
+
+	old = malloc (old_slots * sizeof *old);
+	if (old == NULL)
+		return false;
+	if (inode_read_at (dir->inode, old, old_slots * sizeof *old, 0)
+			!= (off_t) (old_slots * sizeof *old))
+		goto done;
+	for (i = 0; i < old_slots; i++)
+		if (old[i].in_use)
+			live++;
+
+	slots = 2 * (live + 1) + 1;
+	if (slots < old_slots)
+		slots = old_slots;
+	table = calloc (slots, sizeof *table);
+	if (table == NULL)
+		goto done;
+	table[0].inode_sector = DIR_HASHED_MAGIC;
+	for (i = 0; i <= old_slots; i++) {
+		const struct dir_entry *e = i < old_slots ? &old[i] : new;
+		size_t idx;
+
+		if (!e->in_use)
+			continue;
+		for (idx = home_slot (e->name, slots); table[idx].in_use;
+				idx = next_slot (idx, slots))
+			continue;
+		table[idx] = *e;
+	}
+	success = (inode_write_at (dir->inode, table, slots * sizeof *table, 0)
+			== (off_t) (slots * sizeof *table));
+
+done:
+	free (table);
+	free (old);
+	return success;
+}
+
+/* Searches DIR for a file with the given NAME, consulting the
+ * dentry cache first and filling it in on a miss.  Returns true
+ * and sets *SECTORP to the file's inode sector if the file
+ * exists, otherwise returns false. */
+static bool
+cached_lookup (const struct dir *dir, const char *name,
+		disk_sector_t *sectorp) {
+	disk_sector_t parent = inode_get_inumber (dir->inode);
+	struct dir_entry e;
+	bool negative;
+
+	/* No entry can hold an empty or longer name.  The cache would
+	 * truncate a long one, and an empty one marks an unused
+	 * dentry. */
+	if (*name == '\0' || strlen (name) > NAME_MAX)
+		return false;
+	if (dcache_lookup (parent, name, &negative, sectorp))
+		return !negative;
+	if (lookup (dir, name, &e, NULL)) {
+		dcache_insert (parent, name, false, e.inode_sector);
+		*sectorp = e.inode_sector;
+		return true;
+	}
+	dcache_insert (parent, name, true, 0);
 	return false;
 }
 
@@ -104,19 +402,67 @@ lookup (const struct dir *dir, const char *name,
 bool
 dir_lookup (const struct dir *dir, const char *name,
 		struct inode **inode) {
-	struct dir_entry e;
+	enum diskstat_user old_user;
+	disk_sector_t sector;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	if (lookup (dir, name, &e, NULL))
-		*inode = inode_open (e.inode_sector);
+	rwlock_acquire_read (&dir_lock);
+	old_user = disk_user_begin (DISKSTAT_FS_META);
+	if (cached_lookup (dir, name, &sector))
+		*inode = inode_open (sector);
 	else
 		*inode = NULL;
+	disk_user_end (old_user);
+	rwlock_release_read (&dir_lock);
 
 	return *inode != NULL;
 }
 
+/* Writes E into the first free slot of linear directory DIR, or
+ * at the end of DIR if there is none.  A directory that is
+ * already DIR_LINEAR_MAX entries long is converted to the hashed
+ * format instead of growing.
+ * Returns true if successful, false on failure. */
+static bool
+add_linear (struct dir *dir, const struct dir_entry *e) {
+	struct dir_entry slot;
+	size_t idx;
+
+	/* inode_read_at() will only return a short read at end of file.
+	 * Otherwise, we'd need to verify that we didn't get a short
+	 * read due to something intermittent such as low memory. */
+	for (idx = 0; read_slot (dir, idx, &slot); idx++)
+		if (!slot.in_use)
+			break;
+	if (idx >= DIR_LINEAR_MAX && idx == dir_slots (dir))
+		return rehash (dir, e);
+	return (inode_write_at (dir->inode, e, sizeof *e, idx * sizeof *e)
+			== sizeof *e);
+}
+
+/* Writes E into the first free slot of its probe sequence in
+ * hashed directory DIR, or rebuilds DIR if there is none close
+ * to its home slot.
+ * Returns true if successful, false on failure. */
+static bool
+add_hashed (struct dir *dir, const struct dir_entry *e) {
+	size_t slots = dir_slots (dir);
+	struct dir_entry slot;
+	size_t idx, i;
+
+	for (i = 0, idx = home_slot (e->name, slots); i < DIR_PROBE_MAX
+			&& i < slots - 1; i++, idx = next_slot (idx, slots)) {
+		if (!read_slot (dir, idx, &slot))
+			return false;
+		if (!slot.in_use)
+			return (inode_write_at (dir->inode, e, sizeof *e, idx * sizeof *e)
+					== sizeof *e);
+	}
+	return rehash (dir, e);
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
  * file by that name.  The file's inode is in sector
  * INODE_SECTOR.
@@ -125,8 +471,9 @@ dir_lookup (const struct dir *dir, const char *name,
  * error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
+	enum diskstat_user old_user;
 	struct dir_entry e;
-	off_t ofs;
+	disk_sector_t sector;
 	bool success = false;
 
 	ASSERT (dir != NULL);
@@ -136,29 +483,27 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (*name == '\0' || strlen (name) > NAME_MAX)
 		return false;
 
+	rwlock_acquire_write (&dir_lock);
+	old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	/* Check that NAME is not in use. */
-	if (lookup (dir, name, NULL, NULL))
+	if (cached_lookup (dir, name, &sector))
 		goto done;
 
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
-
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
-
-	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
-	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (is_hashed (dir))
+		success = add_hashed (dir, &e);
+	else
+		success = add_linear (dir, &e);
+	if (success)
+		dcache_insert (inode_get_inumber (dir->inode), name, false,
+				inode_sector);
 
 done:
+	disk_user_end (old_user);
+	rwlock_release_write (&dir_lock);
 	return success;
 }
 
@@ -167,6 +512,7 @@ done:
  * which occurs only if there is no file with the given NAME. */
 bool
 dir_remove (struct dir *dir, const char *name) {
+	enum diskstat_user old_user;
 	struct dir_entry e;
 	struct inode *inode = NULL;
 	bool success = false;
@@ -175,6 +521,9 @@ dir_remove (struct dir *dir, const char *name) {
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
+	rwlock_acquire_write (&dir_lock);
+	old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	/* Find directory entry. */
 	if (!lookup (dir, name, &e, &ofs))
 		goto done;
@@ -191,9 +540,12 @@ dir_remove (struct dir *dir, const char *name) {
 
 	/* Remove inode. */
 	inode_remove (inode);
+	dcache_insert (inode_get_inumber (dir->inode), name, true, 0);
 	success = true;
 
 done:
+	disk_user_end (old_user);
+	rwlock_release_write (&dir_lock);
 	inode_close (inode);
 	return success;
 }
@@ -203,14 +555,21 @@ done:
  * contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1]) {
+	enum diskstat_user old_user;
 	struct dir_entry e;
+	bool found = false;
 
+	rwlock_acquire_read (&dir_lock);
+	old_user = disk_user_begin (DISKSTAT_FS_META);
 	while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) {
 		dir->pos += sizeof e;
 		if (e.in_use) {
 			strlcpy (name, e.name, NAME_MAX + 1);
-			return true;
+			found = true;
+			break;
 		}
 	}
-	return false;
+	disk_user_end (old_user);
+	rwlock_release_read (&dir_lock);
+	return found;
 }
@@ -3,6 +3,8 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include <bitmap.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -16,23 +18,35 @@ struct fat_boot {
 	unsigned int root_dir_cluster;
 };
 
+/* Number of cursors in the chain walk cache. */
+#define FAT_WALK_CNT 16
+
 /* FAT FS */
 struct fat_fs {
 	struct fat_boot bs;
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
-	struct lock write_lock;
+	cluster_t last_clst;            /* Where the next free search starts. */
+	struct lock write_lock;         /* Protects everything below and
+	                                   changes to `fat'. */
+	struct bitmap *used;            /* One bit per cluster, true if in use. */
+	struct bitmap *dirty;           /* One bit per FAT sector, true if it
+	                                   changed since it was written. */
+	struct fat_cursor walks[FAT_WALK_CNT]; /* Chain walk cache. */
 };
 
 static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_index_init (void);
+static void set_entry (cluster_t clst, cluster_t val);
 
 void
 fat_init (void) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	fat_fs = calloc (1, sizeof (struct fat_fs));
 	if (fat_fs == NULL)
 		PANIC ("FAT init failed");
@@ -49,39 +63,55 @@ fat_init (void) {
 	if (fat_fs->bs.magic != FAT_MAGIC)
 		fat_boot_create ();
 	fat_fs_init ();
+	disk_user_end (old_user);
+}
+
+/* Returns the number of sectors at the start of the on-disk FAT
+ * that hold entries of the in-memory table. */
+static unsigned
+fat_table_sectors (void) {
+	unsigned used = DIV_ROUND_UP (fat_fs->fat_length * sizeof (cluster_t),
+			DISK_SECTOR_SIZE);
+	return used < fat_fs->bs.fat_sectors ? used : fat_fs->bs.fat_sectors;
 }
 
 void
 fat_open (void) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT load failed");
 
-	// Load FAT directly from the disk
+	// Load FAT directly from the disk, in one vectored request
+	// whose last sector goes through a bounce buffer if the table
+	// does not fill it.
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_read = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_read;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i,
-			           buffer + bytes_read);
-			bytes_read += DISK_SECTOR_SIZE;
-		} else {
-			uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT load failed");
-			disk_read (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			memcpy (buffer + bytes_read, bounce, bytes_left);
-			bytes_read += bytes_left;
-			free (bounce);
-		}
-	}
+	const unsigned fat_sectors = fat_table_sectors ();
+	const off_t tail = fat_size_in_bytes % DISK_SECTOR_SIZE;
+	void **bufs = malloc (fat_sectors * sizeof *bufs);
+	uint8_t *bounce = malloc (DISK_SECTOR_SIZE);
+	if (bufs == NULL || bounce == NULL)
+		PANIC ("FAT load failed");
+	for (unsigned i = 0; i < fat_sectors; i++)
+		bufs[i] = buffer + i * DISK_SECTOR_SIZE;
+	if (tail != 0)
+		bufs[fat_sectors - 1] = bounce;
+	disk_readv (filesys_disk, fat_fs->bs.fat_start, bufs, fat_sectors);
+	if (tail != 0)
+		memcpy (buffer + fat_size_in_bytes - tail, bounce, tail);
+	free (bounce);
+	free (bufs);
+	fat_index_init ();
+	disk_user_end (old_user);
 }
 
 void
 fat_close (void) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	// Write FAT boot sector
 	uint8_t *bounce = calloc (1, DISK_SECTOR_SIZE);
 	if (bounce == NULL)
@@ -90,39 +120,57 @@ fat_close (void) {
 	disk_write (filesys_disk, FAT_BOOT_SECTOR, bounce);
 	free (bounce);
 
-	// Write FAT directly to the disk
+	// Write the FAT sectors that changed since they were last
+	// written, one vectored request per run of dirty sectors.  The
+	// last sector is padded with zeros through a bounce buffer if
+	// the table does not fill it.
 	uint8_t *buffer = (uint8_t *) fat_fs->fat;
-	off_t bytes_wrote = 0;
-	off_t bytes_left = sizeof (fat_fs->fat);
 	const off_t fat_size_in_bytes = fat_fs->fat_length * sizeof (cluster_t);
-	for (unsigned i = 0; i < fat_fs->bs.fat_sectors; i++) {
-		bytes_left = fat_size_in_bytes - bytes_wrote;
-		if (bytes_left >= DISK_SECTOR_SIZE) {
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i,
-			            buffer + bytes_wrote);
-			bytes_wrote += DISK_SECTOR_SIZE;
-		} else {
-			bounce = calloc (1, DISK_SECTOR_SIZE);
-			if (bounce == NULL)
-				PANIC ("FAT close failed");
-			memcpy (bounce, buffer + bytes_wrote, bytes_left);
-			disk_write (filesys_disk, fat_fs->bs.fat_start + i, bounce);
-			bytes_wrote += bytes_left;
-			free (bounce);
+	const unsigned fat_sectors = fat_table_sectors ();
+	const off_t tail = fat_size_in_bytes % DISK_SECTOR_SIZE;
+	const void **bufs = malloc (fat_sectors * sizeof *bufs);
+	bounce = calloc (1, DISK_SECTOR_SIZE);
+	if (bufs == NULL || bounce == NULL)
+		PANIC ("FAT close failed");
+	lock_acquire (&fat_fs->write_lock);
+	size_t first = 0;
+	while ((first = bitmap_scan (fat_fs->dirty, first, 1, true))
+			!= BITMAP_ERROR) {
+		size_t cnt = 1;
+		while (first + cnt < fat_sectors
+				&& bitmap_test (fat_fs->dirty, first + cnt))
+			cnt++;
+		for (size_t i = 0; i < cnt; i++)
+			bufs[i] = buffer + (first + i) * DISK_SECTOR_SIZE;
+		if (tail != 0 && first + cnt == fat_sectors) {
+			memcpy (bounce, buffer + fat_size_in_bytes - tail, tail);
+			bufs[cnt - 1] = bounce;
 		}
+		disk_writev (filesys_disk, fat_fs->bs.fat_start + first, bufs, cnt);
+		bitmap_set_multiple (fat_fs->dirty, first, cnt, false);
+		first += cnt;
 	}
+	lock_release (&fat_fs->write_lock);
+	free (bounce);
+	free (bufs);
+	disk_user_end (old_user);
 }
 
 void
 fat_create (void) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	// Create FAT boot
 	fat_boot_create ();
 	fat_fs_init ();
 
-	// Create FAT table
+	// Create FAT table, all of which must be written out
+	free (fat_fs->fat);
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_index_init ();
+	bitmap_set_all (fat_fs->dirty, true);
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -133,6 +181,7 @@ fat_create (void) {
 		PANIC ("FAT create failed due to OOM");
 	disk_write (filesys_disk, cluster_to_sector (ROOT_DIR_CLUSTER), buf);
 	free (buf);
+	disk_user_end (old_user);
 }
 
 void
@@ -152,42 +201,203 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	unsigned max_length = fat_fs->bs.fat_sectors
+		* (DISK_SECTOR_SIZE / sizeof (cluster_t));
+
+	/* Cluster 0 is never used, so that a zero FAT entry can mean
+	 * "free"; data clusters are numbered from 1. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+		/ SECTORS_PER_CLUSTER + 1;
+	if (fat_fs->fat_length > max_length)
+		fat_fs->fat_length = max_length;
+	fat_fs->last_clst = ROOT_DIR_CLUSTER;
+	lock_init (&fat_fs->write_lock);
+}
+
+/* Builds the free-cluster bitmap from the in-memory FAT and
+ * creates an empty dirty-sector bitmap, so that allocation never
+ * scans the FAT itself. */
+static void
+fat_index_init (void) {
+	bitmap_destroy (fat_fs->used);
+	bitmap_destroy (fat_fs->dirty);
+	fat_fs->used = bitmap_create (fat_fs->fat_length);
+	fat_fs->dirty = bitmap_create (fat_table_sectors ());
+	if (fat_fs->used == NULL || fat_fs->dirty == NULL)
+		PANIC ("FAT index creation failed");
+
+	bitmap_mark (fat_fs->used, 0);
+	for (cluster_t clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->used, clst);
+	memset (fat_fs->walks, 0, sizeof fat_fs->walks);
 }
 
 /*----------------------------------------------------------------------------*/
 /* FAT handling                                                               */
 /*----------------------------------------------------------------------------*/
 
+/* Sets FAT entry CLST to VAL and keeps the free-cluster and dirty
+ * sector bitmaps in step.  The caller must hold the write lock. */
+static void
+set_entry (cluster_t clst, cluster_t val) {
+	ASSERT (clst >= 1 && clst < fat_fs->fat_length);
+
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->used, clst, val != 0);
+	bitmap_mark (fat_fs->dirty, clst * sizeof (cluster_t) / DISK_SECTOR_SIZE);
+}
+
 /* Add a cluster to the chain.
  * If CLST is 0, start a new chain.
- * Returns 0 if fails to allocate a new cluster. */
+ * Returns 0 if fails to allocate a new cluster.
+ * The cluster right after CLST is preferred, so that a chain
+ * grown one cluster at a time stays contiguous on disk;
+ * otherwise the free-cluster bitmap is searched from `last_clst'
+ * onward, wrapping around once. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	size_t new;
+
+	lock_acquire (&fat_fs->write_lock);
+	if (clst != 0 && clst + 1 < fat_fs->fat_length
+			&& !bitmap_test (fat_fs->used, clst + 1))
+		new = clst + 1;
+	else {
+		new = bitmap_scan (fat_fs->used, fat_fs->last_clst, 1, false);
+		if (new == BITMAP_ERROR)
+			new = bitmap_scan (fat_fs->used, 1, 1, false);
+	}
+
+	if (new != BITMAP_ERROR) {
+		set_entry (new, EOChain);
+		if (clst != 0)
+			set_entry (clst, new);
+		fat_fs->last_clst = new + 1 < fat_fs->fat_length ? new + 1 : 1;
+	} else
+		new = 0;
+	lock_release (&fat_fs->write_lock);
+	return new;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		set_entry (pclst, EOChain);
+	while (clst != EOChain) {
+		cluster_t next = fat_fs->fat[clst];
+		set_entry (clst, 0);
+		clst = next;
+	}
+
+	/* Cached cursors may pass through the freed clusters. */
+	memset (fat_fs->walks, 0, sizeof fat_fs->walks);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	set_entry (clst, val);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst >= 1 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
+}
+
+/* Returns cluster IDX (counting from 0) of the chain that starts
+ * at START, or 0 if the chain is shorter than that.
+ * Keeps a cursor per recently walked chain, keyed by START, so
+ * that walking through a long chain does not restart from its
+ * head every time. */
+cluster_t
+fat_walk (cluster_t start, size_t idx) {
+	struct fat_cursor *c = &fat_fs->walks[start % FAT_WALK_CNT];
+	cluster_t clst;
+
+	lock_acquire (&fat_fs->write_lock);
+	if (c->start != start)
+		fat_cursor_init (c, start);
+	clst = fat_cursor_seek (c, idx);
+	lock_release (&fat_fs->write_lock);
+	return clst;
+}
+
+/* Initializes C for the chain that starts at START.
+ * Must be called again whenever that chain is shortened. */
+void
+fat_cursor_init (struct fat_cursor *c, cluster_t start) {
+	c->start = start;
+	c->idx = 0;
+	c->clst = start;
+	c->stride = 1;
+	c->mark_cnt = 1;
+	c->marks[0] = start;
+}
+
+/* Records in C that cluster IDX of its chain is CLST, if IDX is
+ * where the next checkpoint belongs. */
+static void
+cursor_mark (struct fat_cursor *c, size_t idx, cluster_t clst) {
+	if (idx != c->mark_cnt * c->stride)
+		return;
+	if (c->mark_cnt == FAT_CURSOR_MARKS) {
+		/* Keep the even checkpoints and double the stride. */
+		for (size_t i = 0; i < FAT_CURSOR_MARKS / 2; i++)
+			c->marks[i] = c->marks[i * 2];
+		c->mark_cnt = FAT_CURSOR_MARKS / 2;
+		c->stride *= 2;
+		if (idx != c->mark_cnt * c->stride)
+			return;
+	}
+	c->marks[c->mark_cnt++] = clst;
+}
+
+/* Returns cluster IDX (counting from 0) of C's chain, or 0 if the
+ * chain is shorter than that.  Starts from the last cluster found
+ * or the nearest checkpoint at or before IDX, whichever is
+ * closer. */
+cluster_t
+fat_cursor_seek (struct fat_cursor *c, size_t idx) {
+	size_t mark = idx / c->stride;
+	size_t i;
+	cluster_t clst;
+
+	ASSERT (c->start != 0);
+
+	if (mark >= c->mark_cnt)
+		mark = c->mark_cnt - 1;
+	if (c->idx <= idx && c->idx >= mark * c->stride) {
+		i = c->idx;
+		clst = c->clst;
+	} else {
+		i = mark * c->stride;
+		clst = c->marks[mark];
+	}
+
+	while (i < idx) {
+		clst = fat_fs->fat[clst];
+		if (clst == EOChain)
+			return 0;
+		cursor_mark (c, ++i, clst);
+	}
+	c->idx = i;
+	c->clst = clst;
+	return clst;
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst >= 1 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
 }
@@ -3,13 +3,21 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Readahead window limits, in sectors. */
+#define READAHEAD_MIN 4
+#define READAHEAD_MAX 32
+
 /* An open file. */
 struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	off_t ra_next;              /* Where a sequential read would start. */
+	size_t ra_window;           /* Sectors to read ahead, 0 if random. */
 };
 
+static void readahead (struct file *, off_t ofs, off_t size);
+
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
  * allocation fails or if INODE is null. */
@@ -20,6 +28,8 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ra_next = 0;
+		file->ra_window = 0;
 		return file;
 	} else {
 		inode_close (inode);
@@ -72,6 +82,7 @@ file_get_inode (struct file *file) {
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	readahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -83,15 +94,35 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	readahead (file, file_ofs, bytes_read);
+	return bytes_read;
+}
+
+/* Notes that SIZE bytes were just read from FILE at offset OFS.
+ * A read that starts where the previous one ended doubles FILE's
+ * readahead window, up to READAHEAD_MAX sectors, and starts
+ * reading that many sectors past the end of this read into the
+ * buffer cache; any other read closes the window. */
+static void
+readahead (struct file *file, off_t ofs, off_t size) {
+	if (size > 0 && ofs == file->ra_next) {
+		if (file->ra_window == 0)
+			file->ra_window = READAHEAD_MIN;
+		else if (file->ra_window < READAHEAD_MAX)
+			file->ra_window *= 2;
+	} else
+		file->ra_window = 0;
+	file->ra_next = ofs + size;
+
+	if (file->ra_window > 0)
+		inode_readahead (file->inode, file->ra_next, file->ra_window);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the file cannot grow.
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
@@ -103,9 +134,7 @@ file_write (struct file *file, const void *buffer, off_t size) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the file cannot grow.
  * The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -113,6 +142,14 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Writes any of FILE's data that is still only in memory to
+ * disk, returning once it is there. */
+void
+file_sync (struct file *file) {
+	ASSERT (file != NULL);
+	inode_flush (file->inode);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
@@ -1,21 +1,50 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
+#include "devices/disk.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Protects free_map and its file. */
+
+/* Sectors of the free map file whose bits changed since they
+ * were last written, one bit per sector.  Changes reach the disk
+ * only when free_map_flush() is called.  Allocations must be on
+ * disk before any inode that points at them is, so inode.c
+ * flushes before writing inodes and extent blocks; releases may
+ * lag behind, since losing one only leaks sectors. */
+static struct bitmap *dirty_map;
+
+/* Marks the free map file sectors holding the bits for the CNT
+ * sectors starting at SECTOR as changed. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt) {
+	size_t bits_per_sector = DISK_SECTOR_SIZE * 8;
+	size_t first = sector / bits_per_sector;
+	size_t last = (sector + cnt - 1) / bits_per_sector;
+
+	ASSERT (cnt > 0);
+	bitmap_set_multiple (dirty_map, first, last - first + 1, true);
+}
 
 /* Initializes the free map. */
 void
 free_map_init (void) {
+	lock_init (&free_map_lock);
 	free_map = bitmap_create (disk_size (filesys_disk));
 	if (free_map == NULL)
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+				DISK_SECTOR_SIZE));
+	if (dirty_map == NULL)
+		PANIC ("bitmap creation failed--disk is too large");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,54 +53,129 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-	if (sector != BITMAP_ERROR
-			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
-		bitmap_set_multiple (free_map, sector, cnt, false);
-		sector = BITMAP_ERROR;
-	}
+	disk_sector_t sector;
+
+	lock_acquire (&free_map_lock);
+	sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+	if (sector != BITMAP_ERROR && cnt > 0)
+		mark_dirty (sector, cnt);
+	lock_release (&free_map_lock);
 	if (sector != BITMAP_ERROR)
 		*sectorp = sector;
 	return sector != BITMAP_ERROR;
 }
 
+/* Allocates up to CNT consecutive free sectors starting exactly
+ * at SECTOR, stopping at the first sector already in use.
+ * Returns the number of sectors allocated, which is 0 if SECTOR
+ * itself is in use or past the end of the disk. */
+size_t
+free_map_allocate_at (disk_sector_t sector, size_t cnt) {
+	size_t got = 0;
+
+	lock_acquire (&free_map_lock);
+	while (got < cnt && sector + got < bitmap_size (free_map)
+			&& !bitmap_test (free_map, sector + got))
+		got++;
+	if (got > 0) {
+		bitmap_set_multiple (free_map, sector, got, true);
+		mark_dirty (sector, got);
+	}
+	lock_release (&free_map_lock);
+	return got;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt) {
+	lock_acquire (&free_map_lock);
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	if (cnt > 0)
+		mark_dirty (sector, cnt);
+	lock_release (&free_map_lock);
+}
+
+/* Writes the free map file sectors that changed since they were
+ * last written, one request per run of changed sectors, and
+ * returns once they are on disk.
+ * Returns true if successful, false on failure. */
+bool
+free_map_flush (void) {
+	enum diskstat_user old_user;
+	size_t first = 0;
+	bool success = true;
+
+	lock_acquire (&free_map_lock);
+	if (free_map_file == NULL) {
+		lock_release (&free_map_lock);
+		return true;
+	}
+	old_user = disk_user_begin (DISKSTAT_FS_META);
+	while ((first = bitmap_scan (dirty_map, first, 1, true)) != BITMAP_ERROR) {
+		size_t cnt = 1;
+
+		while (first + cnt < bitmap_size (dirty_map)
+				&& bitmap_test (dirty_map, first + cnt))
+			cnt++;
+		if (!bitmap_write_range (free_map, free_map_file,
+					first * DISK_SECTOR_SIZE, cnt * DISK_SECTOR_SIZE)) {
+			success = false;
+			break;
+		}
+		first += cnt;
+	}
+
+	/* The writes may only have reached the buffer cache, but
+	 * callers count on the free map being on disk. */
+	if (success) {
+		file_sync (free_map_file);
+		bitmap_set_all (dirty_map, false);
+	}
+	disk_user_end (old_user);
+	lock_release (&free_map_lock);
+	return success;
 }
 
 /* Opens the free map file and reads it from disk. */
 void
 free_map_open (void) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
 	if (free_map_file == NULL)
 		PANIC ("can't open free map");
 	if (!bitmap_read (free_map, free_map_file))
 		PANIC ("can't read free map");
+	disk_user_end (old_user);
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) {
+	if (!free_map_flush ())
+		PANIC ("can't write free map");
 	file_close (free_map_file);
+	free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
  * it. */
 void
 free_map_create (void) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+
 	/* Create inode. */
 	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
 		PANIC ("free map creation failed");
 
-	/* Write bitmap to file. */
+	/* Write bitmap to file.  It is written whole, so nothing is
+	 * left for free_map_flush(). */
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
 	if (free_map_file == NULL)
 		PANIC ("can't open free map");
+	bitmap_set_all (dirty_map, false);
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
+	disk_user_end (old_user);
 }
@@ -1,22 +1,73 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "threads/mmu.h"
+#endif
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of consecutive disk sectors holding consecutive sectors
+ * of a file. */
+struct extent {
+	uint32_t offset;                    /* First file sector in the run. */
+	disk_sector_t start;                /* First disk sector in the run. */
+	uint32_t cnt;                       /* Number of sectors in the run. */
+	uint32_t flags;                     /* EXTENT_* flags. */
+};
+
+/* Extent flags. */
+#define EXTENT_UNWRITTEN 0x1            /* Allocated but never written:
+                                           reads as zeros, and the disk
+                                           holds garbage. */
+
+/* Number of extents kept in the inode itself and in each
+ * indirect extent block. */
+#define INLINE_EXTENTS 31
+#define BLOCK_EXTENTS 31
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ * The first INLINE_EXTENTS extents of the file are stored here,
+ * sorted by offset; any more are stored BLOCK_EXTENTS at a time
+ * in a chain of extent blocks starting at `next'. */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
+	uint32_t extent_cnt;                /* Number of extents in file. */
+	disk_sector_t next;                 /* First extent block, or 0. */
+	struct extent extents[INLINE_EXTENTS]; /* First extents. */
+};
+
+/* Indirect extent block.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct extent_block {
+	disk_sector_t next;                 /* Next extent block, or 0. */
+	uint32_t unused[3];                 /* Not used. */
+	struct extent extents[BLOCK_EXTENTS]; /* Following extents. */
+};
+
+/* All the extents of an open inode, kept in memory so that
+ * translating an offset never reads an extent block. */
+struct extent_map {
+	struct extent *extents;             /* Sorted by offset. */
+	size_t extent_cnt;                  /* Number of extents. */
+	size_t extent_cap;                  /* Allocated size of `extents'. */
+	disk_sector_t *blocks;              /* Sectors of the extent blocks. */
+	size_t block_cnt;                   /* Number of extent blocks. */
+	size_t dirty;                       /* First extent changed since the
+	                                       map was last written. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,14 +79,25 @@ bytes_to_sectors (off_t size) {
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rw;                   /* Readers share, writers exclude. */
 	struct inode_disk data;             /* Inode content. */
+	struct extent_map map;              /* All of the inode's extents. */
 };
 
+static void map_init (struct extent_map *);
+static void map_destroy (struct extent_map *);
+static bool map_load (struct extent_map *, const struct inode_disk *);
+static bool map_store (struct extent_map *, struct inode_disk *,
+		disk_sector_t);
+static bool map_grow (struct extent_map *, size_t sectors);
+static void map_release (struct extent_map *);
+static const struct extent *map_find (const struct extent_map *, size_t);
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
@@ -43,25 +105,508 @@ struct inode {
 static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
-	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
-	else
+	if (pos < inode->data.length) {
+		size_t sector = pos / DISK_SECTOR_SIZE;
+		const struct extent *e = map_find (&inode->map, sector);
+		return e->start + (sector - e->offset);
+	} else
 		return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* Returns true if byte offset POS, which must be within INODE,
+ * lies in a sector that has never been written. */
+static bool
+sector_unwritten (const struct inode *inode, off_t pos) {
+	return map_find (&inode->map, pos / DISK_SECTOR_SIZE)->flags
+		& EXTENT_UNWRITTEN;
+}
+
+/* Returns the number of whole sectors, at most SIZE /
+ * DISK_SECTOR_SIZE, that follow sector-aligned offset POS in
+ * INODE and lie at consecutive sectors on disk in the same
+ * extent, so that one multi-sector disk command can move them
+ * all. */
+static size_t
+sector_run (const struct inode *inode, off_t pos, off_t size) {
+	size_t sector = pos / DISK_SECTOR_SIZE;
+	const struct extent *e = map_find (&inode->map, sector);
+	size_t max = size / DISK_SECTOR_SIZE;
+	size_t cnt = e->offset + e->cnt - sector;
+
+	ASSERT (pos % DISK_SECTOR_SIZE == 0);
+	return cnt < max ? cnt : max;
+}
+
+/* Initializes M as an empty extent map. */
+static void
+map_init (struct extent_map *m) {
+	m->extents = NULL;
+	m->extent_cnt = m->extent_cap = 0;
+	m->blocks = NULL;
+	m->block_cnt = 0;
+	m->dirty = 0;
+}
+
+/* Frees the memory held by M, but not the sectors it maps. */
+static void
+map_destroy (struct extent_map *m) {
+	free (m->extents);
+	free (m->blocks);
+	map_init (m);
+}
+
+/* Returns the number of file sectors that M maps. */
+static size_t
+map_sectors (const struct extent_map *m) {
+	const struct extent *last;
+
+	if (m->extent_cnt == 0)
+		return 0;
+	last = &m->extents[m->extent_cnt - 1];
+	return last->offset + last->cnt;
+}
+
+/* Returns the extent in M that maps file sector SECTOR, which
+ * must be mapped. */
+static const struct extent *
+map_find (const struct extent_map *m, size_t sector) {
+	size_t lo = 0, hi = m->extent_cnt;
+
+	ASSERT (sector < map_sectors (m));
+
+	/* Find the last extent whose offset is at most SECTOR. */
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (m->extents[mid].offset <= sector)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return &m->extents[lo];
+}
+
+/* Makes room in M for at least CNT extents.
+ * Returns true if successful, false on memory allocation
+ * failure. */
+static bool
+map_reserve (struct extent_map *m, size_t cnt) {
+	if (cnt > m->extent_cap) {
+		size_t cap = m->extent_cap > 0 ? m->extent_cap : INLINE_EXTENTS;
+		struct extent *extents;
+
+		while (cap < cnt)
+			cap *= 2;
+		extents = realloc (m->extents, cap * sizeof *extents);
+		if (extents == NULL)
+			return false;
+		m->extents = extents;
+		m->extent_cap = cap;
+	}
+	return true;
+}
+
+/* Appends block sector SECTOR to M.
+ * Returns true if successful, false on memory allocation
+ * failure. */
+static bool
+map_push_block (struct extent_map *m, disk_sector_t sector) {
+	disk_sector_t *blocks = realloc (m->blocks,
+			(m->block_cnt + 1) * sizeof *blocks);
+	if (blocks == NULL)
+		return false;
+	m->blocks = blocks;
+	m->blocks[m->block_cnt++] = sector;
+	return true;
+}
+
+/* Loads into empty map M the extents of DISK_INODE, following
+ * its chain of extent blocks.
+ * Returns true if successful, false on memory allocation
+ * failure. */
+static bool
+map_load (struct extent_map *m, const struct inode_disk *disk_inode) {
+	size_t cnt = disk_inode->extent_cnt;
+	size_t inline_cnt = cnt < INLINE_EXTENTS ? cnt : INLINE_EXTENTS;
+	struct extent_block *block = NULL;
+	disk_sector_t next = disk_inode->next;
+
+	ASSERT (m->extent_cnt == 0);
+	if (!map_reserve (m, cnt))
+		return false;
+	memcpy (m->extents, disk_inode->extents, inline_cnt * sizeof *m->extents);
+	m->extent_cnt = inline_cnt;
+
+	while (m->extent_cnt < cnt) {
+		size_t block_cnt = cnt - m->extent_cnt;
+
+		ASSERT (next != 0);
+		if (block == NULL && (block = malloc (sizeof *block)) == NULL)
+			return false;
+		if (!map_push_block (m, next)) {
+			free (block);
+			return false;
+		}
+		disk_read (filesys_disk, next, block);
+		if (block_cnt > BLOCK_EXTENTS)
+			block_cnt = BLOCK_EXTENTS;
+		memcpy (m->extents + m->extent_cnt, block->extents,
+				block_cnt * sizeof *m->extents);
+		m->extent_cnt += block_cnt;
+		next = block->next;
+	}
+	free (block);
+	m->dirty = m->extent_cnt;
+	return true;
+}
+
+/* Writes M's extents into DISK_INODE and writes DISK_INODE to
+ * SECTOR, along with every extent block whose contents changed
+ * since M was last stored.  Allocates and frees extent blocks
+ * as needed, and writes the free map before any of them unless
+ * SECTOR is the free map's own inode.
+ * Returns true if successful, false if memory or disk allocation
+ * fails. */
+static bool
+map_store (struct extent_map *m, struct inode_disk *disk_inode,
+		disk_sector_t sector) {
+	size_t cnt = m->extent_cnt;
+	size_t need = (cnt > INLINE_EXTENTS
+			? DIV_ROUND_UP (cnt - INLINE_EXTENTS, BLOCK_EXTENTS) : 0);
+	struct extent_block *block = NULL;
+	size_t i;
+
+	/* Allocate new extent blocks.  Appending a block changes its
+	 * predecessor's `next', so that block must be rewritten too. */
+	while (m->block_cnt < need) {
+		disk_sector_t block_sector;
+		size_t prev_first = (m->block_cnt > 0
+				? INLINE_EXTENTS + (m->block_cnt - 1) * BLOCK_EXTENTS : 0);
+
+		if (!free_map_allocate (1, &block_sector))
+			return false;
+		if (!map_push_block (m, block_sector)) {
+			free_map_release (block_sector, 1);
+			return false;
+		}
+		if (m->dirty > prev_first)
+			m->dirty = prev_first;
+	}
+
+	/* The sectors about to be pointed at must be marked in use on
+	 * disk first.  The free map's own inode is stored while
+	 * free_map_flush() writes it, and its sectors are already in
+	 * use in the map being written, so it does not flush. */
+	if (sector != FREE_MAP_SECTOR && !free_map_flush ())
+		return false;
+
+	/* Write the changed extent blocks. */
+	for (i = 0; i < need; i++) {
+		size_t first = INLINE_EXTENTS + i * BLOCK_EXTENTS;
+		size_t block_cnt = cnt - first;
+
+		if (first + BLOCK_EXTENTS <= m->dirty)
+			continue;
+		if (block == NULL && (block = calloc (1, sizeof *block)) == NULL)
+			return false;
+		if (block_cnt > BLOCK_EXTENTS)
+			block_cnt = BLOCK_EXTENTS;
+		block->next = i + 1 < need ? m->blocks[i + 1] : 0;
+		memcpy (block->extents, m->extents + first,
+				block_cnt * sizeof *block->extents);
+		memset (block->extents + block_cnt, 0,
+				(BLOCK_EXTENTS - block_cnt) * sizeof *block->extents);
+		disk_write (filesys_disk, m->blocks[i], block);
+	}
+	free (block);
+
+	/* Write the inode. */
+	disk_inode->extent_cnt = cnt;
+	disk_inode->next = need > 0 ? m->blocks[0] : 0;
+	memset (disk_inode->extents, 0, sizeof disk_inode->extents);
+	memcpy (disk_inode->extents, m->extents,
+			(cnt < INLINE_EXTENTS ? cnt : INLINE_EXTENTS) * sizeof *m->extents);
+	disk_write (filesys_disk, sector, disk_inode);
+	m->dirty = cnt;
+
+	/* Merging extents may have emptied the last blocks. */
+	while (m->block_cnt > need)
+		free_map_release (m->blocks[--m->block_cnt], 1);
+	return true;
+}
+
+/* Appends to M an extent for the CNT sectors starting at disk
+ * sector START, which become file sectors OFFSET onward.
+ * M must have room for it. */
+static void
+map_append (struct extent_map *m, size_t offset, disk_sector_t start,
+		size_t cnt, uint32_t flags) {
+	struct extent *e = &m->extents[m->extent_cnt];
+
+	ASSERT (m->extent_cnt < m->extent_cap);
+	e->offset = offset;
+	e->start = start;
+	e->cnt = cnt;
+	e->flags = flags;
+	if (m->dirty > m->extent_cnt)
+		m->dirty = m->extent_cnt;
+	m->extent_cnt++;
+}
+
+/* Extends M with unwritten sectors until it maps SECTORS file
+ * sectors.  Nothing is written to the new sectors.  Sectors
+ * right after the last extent are claimed first, so that a file
+ * written sequentially stays in one run on disk; after that,
+ * the largest free run that is not longer than needed is taken.
+ * Returns true if successful, false if memory or disk allocation
+ * fails, in which case the sectors taken so far are released and
+ * M is left as it was. */
+static bool
+map_grow (struct extent_map *m, size_t sectors) {
+	size_t old_cnt = m->extent_cnt;
+	size_t old_last = old_cnt > 0 ? m->extents[old_cnt - 1].cnt : 0;
+	size_t old_dirty = m->dirty;
+	size_t have = map_sectors (m);
+
+	while (have < sectors) {
+		size_t need = sectors - have;
+		struct extent *last;
+		disk_sector_t start;
+		size_t cnt = 0;
+
+		if (!map_reserve (m, m->extent_cnt + 1))
+			goto fail;
+		last = m->extent_cnt > 0 ? &m->extents[m->extent_cnt - 1] : NULL;
+
+		/* Grow in place after the last extent. */
+		if (last != NULL) {
+			start = last->start + last->cnt;
+			cnt = free_map_allocate_at (start, need);
+			if (cnt > 0 && (last->flags & EXTENT_UNWRITTEN)) {
+				last->cnt += cnt;
+				if (m->dirty > m->extent_cnt - 1)
+					m->dirty = m->extent_cnt - 1;
+			} else if (cnt > 0)
+				map_append (m, have, start, cnt, EXTENT_UNWRITTEN);
+		}
+
+		/* Otherwise start a new extent, halving the request
+		 * until a free run is found. */
+		if (cnt == 0) {
+			for (cnt = need; !free_map_allocate (cnt, &start); cnt = (cnt + 1) / 2)
+				if (cnt == 1)
+					goto fail;
+			map_append (m, have, start, cnt, EXTENT_UNWRITTEN);
+		}
+		have += cnt;
+	}
+	return true;
+
+fail:
+	/* Give back the new extents and the sectors added to the old
+	 * last one. */
+	while (m->extent_cnt > old_cnt) {
+		const struct extent *e = &m->extents[--m->extent_cnt];
+		free_map_release (e->start, e->cnt);
+	}
+	if (old_cnt > 0 && m->extents[old_cnt - 1].cnt > old_last) {
+		struct extent *last = &m->extents[old_cnt - 1];
+		free_map_release (last->start + old_last, last->cnt - old_last);
+		last->cnt = old_last;
+	}
+	m->dirty = old_dirty;
+	return false;
+}
+
+/* Records in M that the CNT file sectors starting at SECTOR,
+ * which lie in a single unwritten extent, now hold data.  Splits
+ * that extent in up to three and merges the written part with
+ * written neighbors that continue it on disk.  M must have room
+ * for two more extents. */
+static void
+map_mark_written (struct extent_map *m, size_t sector, size_t cnt) {
+	size_t i = map_find (m, sector) - m->extents;
+	struct extent old = m->extents[i];
+	struct extent parts[3];
+	size_t part_cnt = 0, changed = i;
+	size_t before = sector - old.offset;
+	size_t after = old.offset + old.cnt - (sector + cnt);
+
+	ASSERT (old.flags & EXTENT_UNWRITTEN);
+	ASSERT (sector + cnt <= old.offset + old.cnt);
+	ASSERT (m->extent_cnt + 2 <= m->extent_cap);
+
+	if (before > 0)
+		parts[part_cnt++] = (struct extent) {
+			old.offset, old.start, before, EXTENT_UNWRITTEN };
+	parts[part_cnt++] = (struct extent) {
+		sector, old.start + before, cnt, 0 };
+	if (after > 0)
+		parts[part_cnt++] = (struct extent) {
+			sector + cnt, old.start + before + cnt, after, EXTENT_UNWRITTEN };
+
+	/* Replace the old extent by the parts. */
+	memmove (&m->extents[i + part_cnt], &m->extents[i + 1],
+			(m->extent_cnt - i - 1) * sizeof *m->extents);
+	memcpy (&m->extents[i], parts, part_cnt * sizeof *parts);
+	m->extent_cnt += part_cnt - 1;
+
+	/* Merge the written part with its neighbors. */
+	i += before > 0;
+	if (after == 0 && i + 1 < m->extent_cnt) {
+		struct extent *e = &m->extents[i], *next = e + 1;
+		if (next->flags == 0 && e->start + e->cnt == next->start) {
+			e->cnt += next->cnt;
+			memmove (next, next + 1,
+					(m->extent_cnt - i - 2) * sizeof *m->extents);
+			m->extent_cnt--;
+		}
+	}
+	if (before == 0 && i > 0) {
+		struct extent *prev = &m->extents[i - 1], *e = prev + 1;
+		if (prev->flags == 0 && prev->start + prev->cnt == e->start) {
+			prev->cnt += e->cnt;
+			memmove (e, e + 1, (m->extent_cnt - i - 1) * sizeof *m->extents);
+			m->extent_cnt--;
+			changed = i - 1;
+		}
+	}
+	if (m->dirty > changed)
+		m->dirty = changed;
+}
+
+/* Releases every sector mapped by M, and its extent blocks. */
+static void
+map_release (struct extent_map *m) {
+	size_t i;
+
+	for (i = 0; i < m->extent_cnt; i++) {
+		cache_discard (m->extents[i].start, m->extents[i].cnt);
+		free_map_release (m->extents[i].start, m->extents[i].cnt);
+	}
+	for (i = 0; i < m->block_cnt; i++)
+		free_map_release (m->blocks[i], 1);
+}
+
+/* Sectors in the page-sized bounce buffer used by
+ * inode_read_at() and inode_write_at() for partial sectors and
+ * for user buffers whose frames cannot be handed to the disk. */
+#define BOUNCE_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Most sectors moved between the disk and a user buffer's frames
+ * in one request. */
+#define DIRECT_SECTORS 32
+
+/* Takes the calling thread's bounce buffer, or allocates a new one
+ * if the thread has none or is already using its own, as when a
+ * page fault in the middle of a copy reads another file.
+ * Returns a null pointer if memory allocation fails. */
+static uint8_t *
+bounce_get (void) {
+	struct thread *t = thread_current ();
+	uint8_t *bounce = t->fs_bounce;
+
+	if (bounce == NULL)
+		return palloc_get_page (0);
+	t->fs_bounce = NULL;
+	return bounce;
+}
+
+/* Gives BOUNCE, from bounce_get(), back to the calling thread to
+ * reuse.  BOUNCE may be a null pointer. */
+static void
+bounce_put (uint8_t *bounce) {
+	struct thread *t = thread_current ();
+
+	if (t->fs_bounce == NULL)
+		t->fs_bounce = bounce;
+	else
+		palloc_free_page (bounce);
+}
+
+/* Reads (if WRITE is false) or writes up to CNT sectors starting
+ * at SECTOR directly to or from the frames behind user buffer
+ * UBUF, through their kernel addresses, since the disk worker
+ * thread does not run in the user's address space.  UBUF must be
+ * pinned and sector-aligned, so that no sector straddles a page.
+ * Returns the number of sectors moved, which is 0 if UBUF is not
+ * such a buffer. */
+static size_t
+user_transfer (disk_sector_t sector, uint8_t *ubuf, size_t cnt, bool write) {
+#ifdef USERPROG
+	uint64_t *pml4 = thread_current ()->pml4;
+	void *bufs[DIRECT_SECTORS];
+	size_t i;
+
+	if (pml4 == NULL || !is_user_vaddr (ubuf)
+			|| (uintptr_t) ubuf % DISK_SECTOR_SIZE != 0)
+		return 0;
+	if (cnt > DIRECT_SECTORS)
+		cnt = DIRECT_SECTORS;
+	for (i = 0; i < cnt; i++) {
+		bufs[i] = pml4_get_page (pml4, ubuf + i * DISK_SECTOR_SIZE);
+		if (bufs[i] == NULL)
+			break;
+	}
+	cnt = i;
+	if (cnt == 0)
+		return 0;
+
+	if (write)
+		disk_writev (filesys_disk, sector, (const void *const *) bufs, cnt);
+	else {
+		disk_readv (filesys_disk, sector, bufs, cnt);
+
+		/* The MMU did not see these stores, so mark the pages
+		 * dirty for mmap write-back and eviction. */
+		for (i = 0; i < cnt; i++)
+			if (i == 0 || pg_ofs (ubuf + i * DISK_SECTOR_SIZE) == 0)
+				pml4_set_dirty (pml4, ubuf + i * DISK_SECTOR_SIZE, true);
+	}
+	return cnt;
+#else
+	return 0;
+#endif
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+ * twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Protects open_inodes and every inode's open_cnt and removed.
+ * File data is protected by each inode's own `rw'. */
+static struct lock open_inodes_lock;
+
+static uint64_t inode_hash (const struct hash_elem *, void *);
+static bool inode_less (const struct hash_elem *, const struct hash_elem *,
+		void *);
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+		PANIC ("open inode table creation failed");
+	lock_init (&open_inodes_lock);
+}
+
+/* Returns a hash value for the inode that contains E. */
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if the inode that contains A comes before the one
+ * that contains B. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+		void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+		< hash_entry (b, struct inode, elem)->sector;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
  * writes the new inode to sector SECTOR on the file system
- * disk.
+ * disk.  The data reads as zeros but is left unwritten, so this
+ * costs the same few writes whatever LENGTH is.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool
@@ -74,23 +619,23 @@ inode_create (disk_sector_t sector, off_t length) {
 	/* If this assertion fails, the inode structure is not exactly
 	 * one sector in size, and you should fix that. */
 	ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
+	ASSERT (sizeof (struct extent_block) == DISK_SECTOR_SIZE);
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
+		struct extent_map map;
+
+		map_init (&map);
 		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
-			success = true; 
-		} 
+		if (map_grow (&map, bytes_to_sectors (length))) {
+			enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_META);
+			success = map_store (&map, disk_inode, sector);
+			disk_user_end (old_user);
+		}
+		if (!success)
+			map_release (&map);
+		map_destroy (&map);
 		free (disk_inode);
 	}
 	return success;
@@ -101,39 +646,61 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	enum diskstat_user old_user;
+	struct hash_elem *e;
 	struct inode *inode;
+	struct inode key;
+
+	lock_acquire (&open_inodes_lock);
 
 	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
-		}
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+		return inode; 
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize.  The inode is read while still holding the lock
+	 * so that a concurrent opener of the same sector cannot see
+	 * it half-initialized. */
 	inode->sector = sector;
+	hash_insert (&open_inodes, &inode->elem);
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	rwlock_init (&inode->rw);
+	map_init (&inode->map);
+	old_user = disk_user_begin (DISKSTAT_FS_META);
 	disk_read (filesys_disk, inode->sector, &inode->data);
+	if (!map_load (&inode->map, &inode->data)) {
+		hash_delete (&open_inodes, &inode->elem);
+		map_destroy (&inode->map);
+		free (inode);
+		inode = NULL;
+	}
+	disk_user_end (old_user);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -153,19 +720,24 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
+	lock_acquire (&open_inodes_lock);
 	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
+		/* Remove from inode table and release lock. */
+		hash_delete (&open_inodes, &inode->elem);
+		lock_release (&open_inodes_lock);
 
-		/* Deallocate blocks if removed. */
+		/* Deallocate blocks if removed, otherwise write back
+		 * its data. */
 		if (inode->removed) {
 			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
-		}
+			map_release (&inode->map);
+		} else
+			inode_flush (inode);
 
+		map_destroy (&inode->map);
 		free (inode); 
-	}
+	} else
+		lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -173,18 +745,24 @@ inode_close (struct inode *inode) {
 void
 inode_remove (struct inode *inode) {
 	ASSERT (inode != NULL);
+	lock_acquire (&open_inodes_lock);
 	inode->removed = true;
+	lock_release (&open_inodes_lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
  * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
+ * than SIZE if an error occurs or end of file is reached.
+ * Any number of readers of one inode proceed together; BUFFER
+ * must not fault into this file system while they do. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_DATA);
 
+	rwlock_acquire_read (&inode->rw);
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -200,45 +778,102 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
+		if (sector_unwritten (inode, offset)) {
+			/* Never written: zeros, without reading the disk. */
+			if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE)
+				chunk_size = sector_run (inode, offset,
+						size < inode_left ? size : inode_left) * DISK_SECTOR_SIZE;
+			memset (buffer + bytes_read, 0, chunk_size);
+		} else if (cache_read (sector_idx, buffer + bytes_read, sector_ofs,
+					chunk_size, chunk_size < DISK_SECTOR_SIZE)) {
+			/* Copied from the buffer cache, which partial sectors
+			 * are read into. */
+		} else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE
+				&& is_kernel_vaddr (buffer + bytes_read)) {
+			/* Read this and any following full sectors that are
+			 * not cached directly into caller's buffer. */
+			size_t cnt = cache_absent_run (sector_idx, sector_run (inode, offset,
+					size < inode_left ? size : inode_left));
+			disk_read_multiple (filesys_disk, sector_idx, buffer + bytes_read,
+					cnt); 
+			chunk_size = cnt * DISK_SECTOR_SIZE;
 		} else {
-			/* Read sector into bounce buffer, then partially copy
+			/* Read full sectors that are not cached straight into
+			 * the frames of a suitably aligned user buffer.
+			 * Otherwise, read into the bounce buffer, then copy
 			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
+			size_t cnt = 1, direct = 0;
+			if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
+				cnt = cache_absent_run (sector_idx, sector_run (inode, offset,
+						size < inode_left ? size : inode_left));
+				direct = user_transfer (sector_idx, buffer + bytes_read, cnt,
+						false);
+				if (cnt > BOUNCE_SECTORS)
+					cnt = BOUNCE_SECTORS;
+				chunk_size = (direct > 0 ? direct : cnt) * DISK_SECTOR_SIZE;
+			}
+			if (direct == 0) {
+				if (bounce == NULL) {
+					bounce = bounce_get ();
+					if (bounce == NULL)
+						break;
+				}
+				disk_read_multiple (filesys_disk, sector_idx, bounce, cnt);
+				memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
 			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
 		}
 
+
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
+	rwlock_release_read (&inode->rw);
+	disk_user_end (old_user);
+	bounce_put (bounce);
 
 	return bytes_read;
 }
 
+/* Extends INODE, whose write lock the caller holds, to LENGTH
+ * bytes.  The new sectors are unwritten, and the new extents
+ * reach the disk along with the rest of the write.
+ * Returns true if successful, false if memory or disk allocation
+ * fails. */
+static bool
+inode_grow (struct inode *inode, off_t length) {
+	ASSERT (rwlock_held_for_write (&inode->rw));
+	if (!map_grow (&inode->map, bytes_to_sectors (length)))
+		return false;
+	inode->data.length = length;
+	return true;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if an error occurs.  A write past end of file
+ * extends the inode, filling any gap with zeros; if the inode
+ * cannot grow, writing stops at the old end of file. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
+	enum diskstat_user old_user;
+	off_t old_length;
 
-	if (inode->deny_write_cnt)
+	rwlock_acquire_write (&inode->rw);
+	if (inode->deny_write_cnt) {
+		rwlock_release_write (&inode->rw);
 		return 0;
+	}
+	old_user = disk_user_begin (DISKSTAT_FS_DATA);
+	old_length = inode->data.length;
+	if (size > 0 && offset + size > inode->data.length
+			&& !inode_grow (inode, offset + size))
+		size = offset < inode->data.length ? inode->data.length - offset : 0;
 
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
@@ -252,48 +887,151 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
 		/* Number of bytes to actually write into this sector. */
 		int chunk_size = size < min_left ? size : min_left;
+		bool unwritten;
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+		/* Marking unwritten sectors as written may split their
+		 * extent in three. */
+		unwritten = sector_unwritten (inode, offset);
+		if (unwritten
+				&& !map_reserve (&inode->map, inode->map.extent_cnt + 2))
+			break;
+
+		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE
+				&& cache_contains (sector_idx)
+				&& cache_write (sector_idx, buffer + bytes_written, 0,
+					DISK_SECTOR_SIZE, false)) {
+			/* Replaced the cached copy, which will be written back
+			 * later. */
+		} else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE
+				&& is_kernel_vaddr (buffer + bytes_written)) {
+			/* Write this and any following full sectors that are
+			 * not cached directly to disk. */
+			size_t cnt = cache_absent_run (sector_idx, sector_run (inode, offset,
+					size < inode_left ? size : inode_left));
+			disk_write_multiple (filesys_disk, sector_idx,
+					buffer + bytes_written, cnt); 
+			chunk_size = cnt * DISK_SECTOR_SIZE;
+		} else if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
+			/* Full sectors from a user buffer are written straight
+			 * from its frames if it is aligned, and otherwise go
+			 * through the bounce buffer, up to a page at a time. */
+			size_t cnt = cache_absent_run (sector_idx, sector_run (inode, offset,
+					size < inode_left ? size : inode_left));
+			size_t direct = user_transfer (sector_idx,
+					(uint8_t *) buffer + bytes_written, cnt, true);
+			if (direct > 0)
+				chunk_size = direct * DISK_SECTOR_SIZE;
+			else {
+				if (bounce == NULL) {
+					bounce = bounce_get ();
+					if (bounce == NULL)
+						break;
+				}
+				if (cnt > BOUNCE_SECTORS)
+					cnt = BOUNCE_SECTORS;
+				chunk_size = cnt * DISK_SECTOR_SIZE;
+				memcpy (bounce, buffer + bytes_written, chunk_size);
+				disk_write_multiple (filesys_disk, sector_idx, bounce, cnt);
+			}
+		} else if (cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+					chunk_size, unwritten)) {
+			/* Partial sectors collect in the cache until written
+			 * back.  The cache reads in the rest of the sector
+			 * first, or if the sector was never written, starts
+			 * from all zeros. */
 		} else {
-			/* We need a bounce buffer. */
+			/* The cache is full of dirty sectors, so read, modify,
+			 * and write the sector through a bounce buffer. */
 			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
+				bounce = bounce_get ();
 				if (bounce == NULL)
 					break;
 			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
+			if (!unwritten && (sector_ofs > 0 || chunk_size < sector_left))
 				disk_read (filesys_disk, sector_idx, bounce);
 			else
 				memset (bounce, 0, DISK_SECTOR_SIZE);
 			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
 			disk_write (filesys_disk, sector_idx, bounce); 
 		}
+		if (unwritten) {
+			/* The sector must hold its data on disk before it is
+			 * recorded as written, or a crash could expose what
+			 * it held before. */
+			cache_flush (sector_idx, DIV_ROUND_UP (chunk_size, DISK_SECTOR_SIZE));
+			map_mark_written (&inode->map, offset / DISK_SECTOR_SIZE,
+					DIV_ROUND_UP (sector_ofs + chunk_size, DISK_SECTOR_SIZE));
+		}
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
+
+	/* Now that the data is on disk or in the cache, record the new
+	 * length and which sectors hold data.  If that fails, the data stays
+	 * visible in memory until a later write stores it. */
+	if (inode->data.length != old_length
+			|| inode->map.dirty < inode->map.extent_cnt) {
+		enum diskstat_user meta_user = disk_user_begin (DISKSTAT_FS_META);
+		map_store (&inode->map, &inode->data, inode->sector);
+		disk_user_end (meta_user);
+	}
+	disk_user_end (old_user);
+	rwlock_release_write (&inode->rw);
+	bounce_put (bounce);
 
 	return bytes_written;
 }
 
+/* Starts reading the CNT sectors of INODE that follow byte
+ * OFFSET into the buffer cache, without waiting for them.
+ * Sectors past end of file or never written are skipped. */
+void
+inode_readahead (struct inode *inode, off_t offset, size_t cnt) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_DATA);
+	off_t pos = ROUND_DOWN (offset, DISK_SECTOR_SIZE);
+	size_t i;
+
+	rwlock_acquire_read (&inode->rw);
+	for (i = 0; i < cnt && pos < inode->data.length;
+			i++, pos += DISK_SECTOR_SIZE)
+		if (!sector_unwritten (inode, pos))
+			cache_prefetch (byte_to_sector (inode, pos));
+	rwlock_release_read (&inode->rw);
+	disk_user_end (old_user);
+}
+
+/* Writes INODE's data that is still in the buffer cache to disk,
+ * returning once it is there.  INODE's length and sector map are
+ * always on disk already. */
+void
+inode_flush (struct inode *inode) {
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_FS_DATA);
+	size_t i;
+
+	rwlock_acquire_read (&inode->rw);
+	for (i = 0; i < inode->map.extent_cnt; i++) {
+		const struct extent *e = &inode->map.extents[i];
+		if (!(e->flags & EXTENT_UNWRITTEN))
+			cache_flush (e->start, e->cnt);
+	}
+	rwlock_release_read (&inode->rw);
+	disk_user_end (old_user);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
 inode_deny_write (struct inode *inode) 
 {
+	rwlock_acquire_write (&inode->rw);
 	inode->deny_write_cnt++;
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+	rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -301,9 +1039,11 @@ inode_deny_write (struct inode *inode)
  * inode_deny_write() on the inode, before closing the inode. */
 void
 inode_allow_write (struct inode *inode) {
+	rwlock_acquire_write (&inode->rw);
 	ASSERT (inode->deny_write_cnt > 0);
 	ASSERT (inode->deny_write_cnt <= inode->open_cnt);
 	inode->deny_write_cnt--;
+	rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -1,8 +1,13 @@
 #ifndef DEVICES_DISK_H
 #define DEVICES_DISK_H
 
+#include <diskstat.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -23,5 +28,66 @@ disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
 
+/* Runs of consecutive sectors, in as few disk commands as
+ * possible.  The `v' variants take one buffer per sector. */
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t cnt);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *,
+		size_t cnt);
+void disk_readv (struct disk *, disk_sector_t, void *const bufs[], size_t cnt);
+void disk_writev (struct disk *, disk_sector_t, const void *const bufs[],
+		size_t cnt);
+
+/* Request priorities.  Each channel's queue serves the most
+ * urgent priority it holds before any other. */
+enum disk_prio {
+	DISK_PRIO_HIGH,             /* A thread is stalled, e.g. swap-in. */
+	DISK_PRIO_NORMAL,           /* Ordinary synchronous I/O. */
+	DISK_PRIO_LOW,              /* Background writeback. */
+	DISK_PRIO_CNT
+};
+
+struct disk_request;
+
+/* Called from the disk's worker thread when request R is
+ * complete, given auxiliary data AUX.  Must not sleep for long:
+ * the next transfer on the channel waits for it. */
+typedef void disk_request_func (struct disk_request *r, void *aux);
+
+/* An asynchronous disk request.  Initialize it with
+ * disk_request_init() or disk_request_initv(), optionally set
+ * `prio', `complete' and `aux', then pass it to disk_submit(). */
+struct disk_request {
+	struct disk *disk;          /* Disk. */
+	disk_sector_t sec_no;       /* First sector. */
+	size_t cnt;                 /* Number of sectors. */
+	bool write;                 /* True to write, false to read. */
+	void *const *bufs;          /* Equally sized buffers for the data. */
+	size_t buf_size;            /* Bytes in each of `bufs'. */
+	void *buf;                  /* Sole buffer, if not scatter-gather. */
+	enum disk_prio prio;        /* Priority. */
+	enum diskstat_user user;    /* Subsystem to account the I/O to. */
+	disk_request_func *complete;    /* Completion function, or null. */
+	void *aux;                  /* Auxiliary data for `complete'. */
+
+	/* Owned by the disk driver. */
+	struct list_elem elem;      /* Channel queue element. */
+	int64_t submit_time;        /* Timer ticks when submitted. */
+	uint64_t submit_tsc;        /* TSC when submitted, for latency. */
+	int64_t deadline;           /* Serve by this tick, if possible. */
+	struct semaphore done;      /* Up'd on completion if no `complete'. */
+};
+
+void disk_request_init (struct disk_request *, struct disk *, disk_sector_t,
+		void *, size_t cnt, bool write);
+void disk_request_initv (struct disk_request *, struct disk *, disk_sector_t,
+		void *const bufs[], size_t cnt, bool write);
+void disk_submit (struct disk_request *);
+void disk_wait (struct disk_request *);
+bool disk_set_scheduler (const char *name);
+
+void disk_get_stats (struct disk *, struct diskstat *);
+enum diskstat_user disk_user_begin (enum diskstat_user);
+void disk_user_end (enum diskstat_user);
+
 void 	register_disk_inspect_intr ();
 #endif /* devices/disk.h */
@@ -0,0 +1,18 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+void cache_init (void);
+bool cache_read (disk_sector_t, void *, int ofs, int size, bool fill);
+bool cache_write (disk_sector_t, const void *, int ofs, int size, bool zero);
+bool cache_contains (disk_sector_t);
+size_t cache_absent_run (disk_sector_t, size_t cnt);
+void cache_prefetch (disk_sector_t);
+void cache_flush (disk_sector_t, size_t cnt);
+void cache_flush_all (void);
+void cache_discard (disk_sector_t, size_t cnt);
+
+#endif /* filesys/cache.h */
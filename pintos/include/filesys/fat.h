@@ -18,6 +18,25 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
+/* Number of checkpoints a struct fat_cursor keeps. */
+#define FAT_CURSOR_MARKS 32
+
+/* Translates chain indexes to clusters for one cluster chain.
+ * Remembers the last cluster it found, so that stepping forward
+ * costs one FAT lookup, and checkpoints spaced `stride' clusters
+ * apart along the part of the chain walked so far, so that a
+ * backward or random seek walks less than one stride.  When the
+ * checkpoints run out, every other one is dropped and the stride
+ * doubles.  A cursor is used by one thread at a time. */
+struct fat_cursor {
+	cluster_t start;            /* First cluster of the chain, or 0. */
+	size_t idx;                 /* Chain index of `clst'. */
+	cluster_t clst;             /* Last cluster found. */
+	size_t stride;              /* Chain indexes between checkpoints. */
+	size_t mark_cnt;            /* Number of checkpoints. */
+	cluster_t marks[FAT_CURSOR_MARKS]; /* marks[i] is cluster i * stride. */
+};
+
 void fat_init (void);
 void fat_open (void);
 void fat_close (void);
@@ -32,6 +51,9 @@ void fat_remove_chain (
     cluster_t pclst /* Previous cluster of clst, 0: clst is the start of chain */
 );
 cluster_t fat_get (cluster_t clst);
+cluster_t fat_walk (cluster_t start, size_t idx);
+void fat_cursor_init (struct fat_cursor *, cluster_t start);
+cluster_t fat_cursor_seek (struct fat_cursor *, size_t idx);
 void fat_put (cluster_t clst, cluster_t val);
 disk_sector_t cluster_to_sector (cluster_t clst);
 
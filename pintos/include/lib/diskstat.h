@@ -0,0 +1,46 @@
+#ifndef __LIB_DISKSTAT_H
+#define __LIB_DISKSTAT_H
+
+/* Disk I/O statistics, as kept by devices/disk.c and returned to
+ * user programs by the diskstat() system call. */
+
+/* Directions. */
+enum diskstat_op {
+	DISKSTAT_READ,              /* Disk to memory. */
+	DISKSTAT_WRITE,             /* Memory to disk. */
+	DISKSTAT_OP_CNT
+};
+
+/* Kernel subsystems that I/O is attributed to. */
+enum diskstat_user {
+	DISKSTAT_OTHER,             /* Anything not below, e.g. fsutil. */
+	DISKSTAT_SWAP,              /* Anonymous pages to and from swap. */
+	DISKSTAT_FS_META,           /* Inodes, directories, free map, FAT. */
+	DISKSTAT_FS_DATA,           /* File contents through read/write. */
+	DISKSTAT_PAGE_CACHE,        /* Executable and mmap'd file pages. */
+	DISKSTAT_USER_CNT
+};
+
+/* Number of latency histogram buckets.  Bucket 0 counts requests
+ * that took less than 2 microseconds, bucket I > 0 those that took
+ * [2**I, 2**(I+1)) microseconds, and the last bucket everything
+ * slower. */
+#define DISKSTAT_BUCKETS 24
+
+/* Statistics for one disk. */
+struct diskstat {
+	long long requests[DISKSTAT_OP_CNT];    /* Requests completed. */
+	long long sectors[DISKSTAT_OP_CNT];     /* Sectors moved. */
+	long long latency_sum[DISKSTAT_OP_CNT]; /* Submit to completion, us. */
+	long long latency_max[DISKSTAT_OP_CNT]; /* Slowest request, us. */
+	long long latency_hist[DISKSTAT_OP_CNT][DISKSTAT_BUCKETS];
+
+	/* Sectors moved on behalf of each subsystem. */
+	long long user_sectors[DISKSTAT_USER_CNT][DISKSTAT_OP_CNT];
+
+	/* Sectors the calling thread has moved on all disks.  Only
+	 * filled in by the diskstat() system call. */
+	long long thread_sectors[DISKSTAT_OP_CNT];
+};
+
+#endif /* lib/diskstat.h */
@@ -0,0 +1,15 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One buffer of a readv() or writev() system call. */
+struct iovec {
+	void *iov_base;             /* Start of buffer. */
+	size_t iov_len;             /* Size of buffer in bytes. */
+};
+
+/* Most buffers that one readv() or writev() call accepts. */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
@@ -0,0 +1,110 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+ *
+ * An alternative to the chained table in hash.h for hot lookup
+ * paths.  Elements are still intrusive: each structure that can
+ * be in an ohash embeds a struct ohash_elem, and ohash_entry()
+ * converts back to the containing structure, exactly like
+ * hash_entry().
+ *
+ * Unlike hash.h, the table itself is a flat array of slots that
+ * hold a pointer to the element together with part of its hash
+ * value, so a probe compares hash bits that are already in cache
+ * and only touches the element on a likely match.  Collisions are
+ * resolved with Robin Hood linear probing, which keeps probe
+ * sequences short even at high load.
+ *
+ * Growing never rehashes the whole table at once.  When the load
+ * factor is exceeded, a table twice the size is allocated and
+ * every following operation moves a few slots from the old table
+ * to the new one; lookups consult both until the old table is
+ * empty. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Open-addressing hash element. */
+struct ohash_elem {
+	uint64_t hash;              /* Cached hash value, set on insert. */
+};
+
+/* Converts pointer to hash element OHASH_ELEM into a pointer to
+ * the structure that OHASH_ELEM is embedded inside.  Supply the
+ * name of the outer structure STRUCT and the member name MEMBER
+ * of the hash element. */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+	((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->hash            \
+		- offsetof (STRUCT, MEMBER.hash)))
+
+/* Computes and returns the hash value for hash element E, given
+ * auxiliary data AUX. */
+typedef uint64_t ohash_hash_func (const struct ohash_elem *e, void *aux);
+
+/* Compares the value of two hash elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool ohash_less_func (const struct ohash_elem *a,
+		const struct ohash_elem *b,
+		void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+ * data AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* One slot of the table.  PSL is the probe sequence length plus
+ * one: zero means the slot has never been used, and a slot with a
+ * nonzero PSL but a null ELEM is a tombstone left behind in the
+ * old table by migration or deletion. */
+struct ohash_slot {
+	uint32_t hash;              /* High 32 bits of the element's hash. */
+	uint32_t psl;               /* Probe sequence length + 1. */
+	struct ohash_elem *elem;    /* Element, or null. */
+};
+
+/* Open-addressing hash table. */
+struct ohash {
+	size_t elem_cnt;            /* Number of elements in table. */
+	size_t slot_cnt;            /* Number of slots, a power of 2. */
+	struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+	size_t old_slot_cnt;        /* Slots in the table being drained. */
+	struct ohash_slot *old_slots; /* Table being drained, or null. */
+	size_t old_elem_cnt;        /* Elements still in `old_slots'. */
+	size_t migrate_idx;         /* Next slot of `old_slots' to move. */
+	ohash_hash_func *hash;      /* Hash function. */
+	ohash_less_func *less;      /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `hash' and `less'. */
+};
+
+/* An open-addressing hash table iterator. */
+struct ohash_iterator {
+	struct ohash *hash;         /* The hash table. */
+	struct ohash_slot *slot;    /* Current slot. */
+	struct ohash_elem *elem;    /* Current hash element. */
+};
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, ohash_hash_func *, ohash_less_func *,
+		void *aux);
+void ohash_clear (struct ohash *, ohash_action_func *);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_replace (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_delete (struct ohash *, struct ohash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct ohash_elem *ohash_next (struct ohash_iterator *);
+struct ohash_elem *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -36,6 +36,18 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra. */
+	SYS_DISKSTAT,               /* Reads disk I/O statistics. */
+	SYS_FSYNC,                  /* Writes a file's data to disk. */
+	SYS_PREAD,                  /* Reads from a file at an offset. */
+	SYS_PWRITE,                 /* Writes to a file at an offset. */
+	SYS_READV,                  /* Reads into several buffers. */
+	SYS_WRITEV,                 /* Writes from several buffers. */
+	SYS_COPY_FILE_RANGE,        /* Copies between files in the kernel. */
+	SYS_PIPE,                   /* Creates an anonymous pipe. */
+	SYS_SHM_ATTACH,             /* Maps a shared memory segment. */
+	SYS_SHM_DETACH,             /* Unmaps a shared memory segment. */
 };
 
 #endif /* lib/syscall-nr.h */
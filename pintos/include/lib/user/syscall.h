@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <diskstat.h>
+#include <iovec.h>
 #include <stddef.h>
 
 /* Process identifier. */
@@ -50,6 +52,19 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Extra. */
+bool diskstat (int chan_no, int dev_no, struct diskstat *);
+int fsync (int fd);
+int pread (int fd, void *buffer, unsigned size, off_t offset);
+int pwrite (int fd, const void *buffer, unsigned size, off_t offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int fd_in, off_t off_in, int fd_out, off_t off_out,
+		unsigned len);
+int pipe (int fds[2]);
+void *shm_attach (int key, size_t size, void *addr);
+bool shm_detach (void *addr);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
@@ -43,6 +43,23 @@ void cond_broadcast (struct condition *, struct lock *);
 
 bool sema_priorty_more(const struct list_elem *a, const struct list_elem *b, void *aux);
 
+/* Readers-writer lock. */
+struct rwlock {
+	struct lock lock;           /* Protects the members below. */
+	struct condition can_read;  /* Signaled when readers may enter. */
+	struct condition can_write; /* Signaled when a writer may enter. */
+	int readers;                /* Number of threads reading. */
+	int waiting_writers;        /* Number of writers waiting. */
+	struct thread *writer;      /* Thread writing, or null. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -11,6 +11,9 @@
 #ifdef VM
 #include "vm/vm.h"
 #endif
+#ifdef USERPROG
+#include "userprog/fdtable.h"
+#endif
 
 struct child_status;
 
@@ -26,13 +29,17 @@ enum thread_status {
 enum fd_type {
 	FD_STDIN,
 	FD_STDOUT,
-	FD_FILE
+	FD_FILE,
+	FD_PIPE_READ,		// 파이프의 읽기 끝
+	FD_PIPE_WRITE		// 파이프의 쓰기 끝
 };
 
 struct file_descriptor{
 	struct file *file;
+	struct pipe *pipe;	// FD_PIPE_* 일 때만
 	int ref_count;
 	enum fd_type type;
+	struct file_descriptor *fork_copy;	// fork 중 자식 쪽 사본, 같은 wrapper 를 가리키는 fd 끼리 공유
 };
 
 /* 스레드 식별자 타입.
@@ -44,8 +51,10 @@ typedef int tid_t;
 #define PRI_MIN 0                       /* 최저 우선순위. */
 #define PRI_DEFAULT 31                  /* 기본 우선순위. */
 #define PRI_MAX 63                      /* 최고 우선순위. */
-/* 파일 디스크립터 최대 */
-#define MAX_FD 512
+/* 파일 디스크립터 최대. fd 테이블은 이만큼까지 늘어난다 (64 의 2^n 배) */
+#define MAX_FD 8192
+/* 유저 경로 문자열을 복사해 두는 스레드별 버퍼 크기 (NUL 포함) */
+#define PATH_BUF_SIZE 256
 
 
 /* 커널 스레드 또는 사용자 프로세스.
@@ -120,7 +129,8 @@ struct thread {
 	struct child_status *child_stat;	// 자식 상태 구조체
 	struct list child_list;             // 자식 리스트
 	struct file *execute_file;			// 실행 중인 파일
-	struct file_descriptor **fd_table; 	// file descriptor table (one table per process)
+	struct fd_table fd_table; 			// file descriptor table (one table per process)
+	char *path_buf;						// 경로 문자열 스크래치 버퍼 (PATH_BUF_SIZE)
 	int exit_status;    
 #endif
 #ifdef VM
@@ -136,6 +146,13 @@ struct thread {
 
 	// time_sleep에서 깨어날 시간
 	int64_t wakeup_tick;
+
+	/* devices/disk.c가 소유함. */
+	int disk_user;                      /* I/O를 집계할 서브시스템 (enum diskstat_user). */
+	long long disk_sectors[2];          /* 이 스레드가 요청한 읽기/쓰기 섹터 수. */
+
+	/* filesys/inode.c가 소유함. */
+	uint8_t *fs_bounce;                 /* 재사용하는 페이지 크기 바운스 버퍼, 없으면 NULL. */
 };
 
 
@@ -0,0 +1,27 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct file_descriptor;
+
+/* 프로세스의 fd 테이블.
+ * used 비트맵에 쓰이는 fd 가 표시돼 있어서 빈 fd 찾기와 열린 fd 순회가
+ * 64 개씩 워드 단위로 넘어간다. 자리가 모자라면 MAX_FD 까지 두 배씩
+ * 늘어난다. */
+struct fd_table {
+	struct file_descriptor **fds;   /* cap 칸. */
+	uint64_t *used;                 /* fd 가 쓰이면 1, cap / 64 워드. */
+	int cap;                        /* 지금 크기, 64 의 배수. */
+};
+
+bool fd_table_init (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+struct file_descriptor *fd_table_get (const struct fd_table *, int fd);
+int fd_table_install (struct fd_table *, int min_fd, struct file_descriptor *);
+bool fd_table_set (struct fd_table *, int fd, struct file_descriptor *);
+struct file_descriptor *fd_table_remove (struct fd_table *, int fd);
+int fd_table_next (const struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -3,11 +3,15 @@
 #include "threads/thread.h"
 
 void syscall_init (void);
-extern struct lock filesys_lock; /* 파일 시스템에 접근할 때 동기화를 보장하기 위한 락*/
 
 struct file_descriptor *create_fd_wrapper(struct file *f, enum fd_type f_type);
 void close_fd(struct file_descriptor *fd_wrapper);
 struct file_descriptor *get_fd_wrapper(int fd);
 
+/* 유저 메모리 복사, 잘못된 주소면 false / -1 */
+bool copy_from_user(void *dst, const void *usrc, size_t size);
+bool copy_to_user(void *udst, const void *src, size_t size);
+int64_t strncpy_from_user(char *dst, const char *usrc, size_t size);
+
 
 #endif /* userprog/syscall.h */
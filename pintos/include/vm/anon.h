@@ -14,5 +14,8 @@ struct anon_page {
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+size_t anon_swap_write (void *kva);
+void anon_swap_read (size_t idx, void *kva);
+void anon_swap_free (size_t idx);
 
 #endif
@@ -0,0 +1,25 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+#include <stdbool.h>
+#include <stddef.h>
+#include "lib/kernel/list.h"
+
+struct page;
+struct shm;
+
+/* 공유 객체의 한 페이지를 프로세스 하나에 매핑한 것.
+   같은 객체 페이지를 가리키는 매핑들은 elem 으로 묶인다. */
+struct shm_page_ref {
+	struct shm *obj;
+	size_t idx;              /* 객체 안에서의 페이지 번호 */
+	struct list_elem elem;   /* shm 페이지의 mappers 리스트 */
+};
+
+void vm_shm_init (void);
+void *do_shm_attach (int key, size_t size, void *addr);
+bool do_shm_detach (void *addr);
+bool shm_claim (struct page *page);
+bool shm_copy_page (struct page *parent);
+bool shm_test_and_clear_accessed (struct page *page);
+
+#endif
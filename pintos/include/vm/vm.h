@@ -13,6 +13,8 @@ enum vm_type {
 	VM_FILE = 2,
 	/* page that hold the page cache, for project 4 */
 	VM_PAGE_CACHE = 3,
+	/* anonymous page shared between processes, see vm/shm.c */
+	VM_SHM = 4,
 
 	/* Bit flags to store state */
 
@@ -28,6 +30,7 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/shm.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -59,6 +62,7 @@ struct page {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
+		struct shm_page_ref shm;
 #ifdef EFILESYS
 		struct page_cache page_cache;
 #endif
@@ -70,7 +74,8 @@ struct frame {
 	void *kva;
 	struct page *page;
 	struct list_elem frame_elem;
-	bool no_victim;
+	int pin_cnt;           /* 0 보다 크면 clock 이 고르지 않는다 */
+	bool evicting;         /* swap_out 중, 끝나면 page 와 끊긴다 */
 };
 
 /* The function table for page operations.
@@ -123,7 +128,10 @@ bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
+struct frame *vm_get_frame (void);
 bool vm_claim_page (void *va);
+bool vm_pin_page (void *va);
+void vm_unpin_page (void *va);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
@@ -26,6 +26,7 @@ typedef unsigned long elem_type;
    simulates an array of bits. */
 struct bitmap {
 	size_t bit_cnt;     /* Number of bits. */
+	size_t next_fit;    /* Where bitmap_scan_and_flip_next_fit() resumes. */
 	elem_type *bits;    /* Elements that represent bits. */
 };
 
@@ -63,6 +64,63 @@ last_mask (const struct bitmap *b) {
 	return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns an elem_type in which the bits numbered FIRST_BIT
+   (inclusive) through LAST_BIT (exclusive) within one element
+   are turned on.  Requires FIRST_BIT < LAST_BIT <= ELEM_BITS. */
+static inline elem_type
+range_mask (size_t first_bit, size_t last_bit) {
+	elem_type high = last_bit < ELEM_BITS
+		? ((elem_type) 1 << last_bit) - 1 : (elem_type) -1;
+	return high & ((elem_type) -1 << first_bit);
+}
+
+/* Returns element IDX of B with every bit inverted if VALUE is
+   false, so that bits equal to VALUE always read as 1. */
+static inline elem_type
+elem_for_value (const struct bitmap *b, size_t idx, bool value) {
+	return value ? b->bits[idx] : ~b->bits[idx];
+}
+
+/* Returns the number of bits set to 1 in X.
+   Done by hand because the kernel does not link against libgcc,
+   which is where __builtin_popcountl() would end up without
+   -mpopcnt. */
+static inline size_t
+popcount (elem_type x) {
+	x = x - ((x >> 1) & 0x5555555555555555UL);
+	x = (x & 0x3333333333333333UL) + ((x >> 2) & 0x3333333333333333UL);
+	x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fUL;
+	return (x * 0x0101010101010101UL) >> 56;
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's bit count if there is none.
+   Whole elements that hold no such bit are skipped with a single
+   compare, and the bit within the first useful element is found
+   with BSF. */
+static size_t
+find_next (const struct bitmap *b, size_t start, bool value) {
+	size_t idx = elem_idx (start);
+	size_t cnt = elem_cnt (b->bit_cnt);
+	elem_type word;
+	size_t bit;
+
+	if (start >= b->bit_cnt)
+		return b->bit_cnt;
+
+	word = elem_for_value (b, idx, value) & ((elem_type) -1 << (start % ELEM_BITS));
+	while (word == 0) {
+		if (++idx >= cnt)
+			return b->bit_cnt;
+		word = elem_for_value (b, idx, value);
+	}
+
+	/* The unused bits of the last element are garbage, so a hit
+	   there means there was no hit at all. */
+	bit = idx * ELEM_BITS + __builtin_ctzl (word);
+	return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -74,6 +132,7 @@ bitmap_create (size_t bit_cnt) {
 	struct bitmap *b = malloc (sizeof *b);
 	if (b != NULL) {
 		b->bit_cnt = bit_cnt;
+		b->next_fit = 0;
 		b->bits = malloc (byte_cnt (bit_cnt));
 		if (b->bits != NULL || bit_cnt == 0) {
 			bitmap_set_all (b, false);
@@ -94,6 +153,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED) {
 	ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
 	b->bit_cnt = bit_cnt;
+	b->next_fit = 0;
 	b->bits = (elem_type *) (b + 1);
 	bitmap_set_all (b, false);
 	return b;
@@ -194,33 +254,53 @@ bitmap_set_all (struct bitmap *b, bool value) {
 	bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element touched is updated with one atomic operation. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
+	size_t end = start + cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		bitmap_set (b, start + i, value);
+	while (start < end) {
+		size_t idx = elem_idx (start);
+		size_t last_bit = end - idx * ELEM_BITS;
+		elem_type mask = range_mask (start % ELEM_BITS,
+				last_bit < ELEM_BITS ? last_bit : ELEM_BITS);
+
+		/* Same as bitmap_mark() and bitmap_reset(), but for every
+		   bit of MASK at once. */
+		if (value)
+			asm ("lock orq %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+		else
+			asm ("lock andq %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+		start = (idx + 1) * ELEM_BITS;
+	}
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i, value_cnt;
+	size_t end = start + cnt;
+	size_t value_cnt;
 
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
 	value_cnt = 0;
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			value_cnt++;
+	while (start < end) {
+		size_t idx = elem_idx (start);
+		size_t last_bit = end - idx * ELEM_BITS;
+		elem_type mask = range_mask (start % ELEM_BITS,
+				last_bit < ELEM_BITS ? last_bit : ELEM_BITS);
+
+		value_cnt += popcount (elem_for_value (b, idx, value) & mask);
+		start = (idx + 1) * ELEM_BITS;
+	}
 	return value_cnt;
 }
 
@@ -228,16 +308,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) {
    exclusive, are set to VALUE, and false otherwise. */
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) {
-	size_t i;
-
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 	ASSERT (start + cnt <= b->bit_cnt);
 
-	for (i = 0; i < cnt; i++)
-		if (bitmap_test (b, start + i) == value)
-			return true;
-	return false;
+	return cnt != 0 && find_next (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -266,18 +341,35 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt) {
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Works a word at a time: find_next() jumps to the next bit equal
+   to VALUE, then to the next bit that is not, and the gap between
+   the two is a whole run that is either long enough or skipped in
+   one step. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) {
 	ASSERT (b != NULL);
 	ASSERT (start <= b->bit_cnt);
 
-	if (cnt <= b->bit_cnt) {
-		size_t last = b->bit_cnt - cnt;
-		size_t i;
-		for (i = start; i <= last; i++)
-			if (!bitmap_contains (b, i, cnt, !value))
-				return i;
+	if (cnt == 0)
+		return start;
+
+	while (cnt <= b->bit_cnt - start) {
+		size_t run_start = find_next (b, start, value);
+		size_t run_end;
+
+		if (cnt > b->bit_cnt - run_start)
+			break;
+
+		/* Fast path: any single bit will do. */
+		if (cnt == 1)
+			return run_start;
+
+		run_end = find_next (b, run_start, !value);
+		if (run_end - run_start >= cnt)
+			return run_start;
+		start = run_end;
 	}
 	return BITMAP_ERROR;
 }
@@ -297,6 +389,28 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value) {
 	return idx;
 }
 
+/* Like bitmap_scan_and_flip(), but starts looking where the
+   previous call left off instead of at a caller-supplied index,
+   wrapping around to bit 0 once.  Allocators that hand out and
+   return slots in roughly FIFO order (swap slots, for example)
+   then do not rescan the busy prefix of B on every call. */
+size_t
+bitmap_scan_and_flip_next_fit (struct bitmap *b, size_t cnt, bool value) {
+	size_t hint, idx;
+
+	ASSERT (b != NULL);
+
+	hint = b->next_fit <= b->bit_cnt ? b->next_fit : 0;
+	idx = bitmap_scan (b, hint, cnt, value);
+	if (idx == BITMAP_ERROR && hint != 0)
+		idx = bitmap_scan (b, 0, cnt, value);
+	if (idx != BITMAP_ERROR) {
+		bitmap_set_multiple (b, idx, cnt, !value);
+		b->next_fit = idx + cnt;
+	}
+	return idx;
+}
+
 /* File input and output. */
 
 #ifdef FILESYS
@@ -326,6 +440,22 @@ bitmap_write (const struct bitmap *b, struct file *file) {
 	off_t size = byte_cnt (b->bit_cnt);
 	return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes bytes OFS through OFS + SIZE - 1 of B's file image to
+   the same offsets in FILE, stopping at the end of the image.
+   Return true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+		off_t ofs, off_t size) {
+	off_t file_size = byte_cnt (b->bit_cnt);
+
+	ASSERT (ofs >= 0 && size >= 0);
+	if (ofs >= file_size)
+		return true;
+	if (size > file_size - ofs)
+		size = file_size - ofs;
+	return file_write_at (file, (uint8_t *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,462 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information.  The element and callback
+   conventions follow hash.c, so a table can be switched from one
+   implementation to the other by changing types and prefixes. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include <string.h>
+#include "threads/malloc.h"
+
+/* Initial number of slots.  Must be a power of 2. */
+#define MIN_SLOT_CNT 8
+
+/* The table grows once it would be more than
+   MAX_LOAD_NUM / MAX_LOAD_DEN full. */
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 8
+
+/* Slots of the old table moved to the new one per insertion or
+   deletion while a resize is in progress.  Growth happens when
+   the old table is 7/8 full and the new table, twice as large,
+   does not need to grow again for at least another 7/8 of the old
+   table's size in insertions, so any value of 2 or more finishes
+   the move long before that. */
+#define MIGRATE_STEP 8
+
+static struct ohash_slot *alloc_slots (size_t slot_cnt);
+static struct ohash_slot *find_slot (struct ohash *, struct ohash_slot *,
+		size_t slot_cnt, struct ohash_elem *);
+static struct ohash_slot *find_any (struct ohash *, struct ohash_elem *);
+static void insert_slot (struct ohash_slot *, size_t slot_cnt,
+		struct ohash_elem *);
+static void remove_slot (struct ohash *, struct ohash_slot *);
+static void migrate (struct ohash *, size_t slot_cnt);
+static void grow (struct ohash *);
+
+/* Returns the part of HASH kept in a slot to filter probes. */
+static inline uint32_t
+hash_tag (uint64_t hash) {
+	return hash >> 32;
+}
+
+/* Returns true if slot S is in the slot array SLOTS of SLOT_CNT
+   slots. */
+static inline bool
+slot_in (const struct ohash_slot *s, const struct ohash_slot *slots,
+		size_t slot_cnt) {
+	return slots != NULL && s >= slots && s < slots + slot_cnt;
+}
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+		ohash_hash_func *hash, ohash_less_func *less, void *aux) {
+	h->elem_cnt = 0;
+	h->slot_cnt = MIN_SLOT_CNT;
+	h->slots = alloc_slots (h->slot_cnt);
+	h->old_slot_cnt = 0;
+	h->old_slots = NULL;
+	h->old_elem_cnt = 0;
+	h->migrate_idx = 0;
+	h->hash = hash;
+	h->less = less;
+	h->aux = aux;
+
+	return h->slots != NULL;
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while ohash_clear() is running, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), yields undefined behavior,
+   whether done in DESTRUCTOR or elsewhere. */
+void
+ohash_clear (struct ohash *h, ohash_action_func *destructor) {
+	if (destructor != NULL)
+		ohash_apply (h, destructor);
+
+	memset (h->slots, 0, sizeof *h->slots * h->slot_cnt);
+	free (h->old_slots);
+	h->old_slots = NULL;
+	h->old_slot_cnt = 0;
+	h->old_elem_cnt = 0;
+	h->migrate_idx = 0;
+	h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash.  The same restrictions as for
+   ohash_clear() apply. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor) {
+	if (destructor != NULL)
+		ohash_clear (h, destructor);
+	free (h->old_slots);
+	free (h->slots);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW.
+   Panics if the table is completely full and cannot be grown
+   for lack of memory. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new) {
+	struct ohash_slot *old;
+
+	migrate (h, MIGRATE_STEP);
+
+	new->hash = h->hash (new, h->aux);
+	old = find_any (h, new);
+	if (old != NULL)
+		return old->elem;
+
+	grow (h);
+	insert_slot (h->slots, h->slot_cnt, new);
+	h->elem_cnt++;
+
+	return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct ohash_elem *
+ohash_replace (struct ohash *h, struct ohash_elem *new) {
+	struct ohash_slot *s;
+	struct ohash_elem *old = NULL;
+
+	migrate (h, MIGRATE_STEP);
+
+	new->hash = h->hash (new, h->aux);
+	s = find_any (h, new);
+	if (s != NULL) {
+		old = s->elem;
+		remove_slot (h, s);
+	}
+
+	grow (h);
+	insert_slot (h->slots, h->slot_cnt, new);
+	h->elem_cnt++;
+
+	return old;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct ohash_elem *
+ohash_find (struct ohash *h, struct ohash_elem *e) {
+	struct ohash_slot *s;
+
+	e->hash = h->hash (e, h->aux);
+	s = find_any (h, e);
+	return s != NULL ? s->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, struct ohash_elem *e) {
+	struct ohash_slot *s;
+	struct ohash_elem *found = NULL;
+
+	migrate (h, MIGRATE_STEP);
+
+	e->hash = h->hash (e, h->aux);
+	s = find_any (h, e);
+	if (s != NULL) {
+		found = s->elem;
+		remove_slot (h, s);
+	}
+	return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while ohash_apply() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), ohash_replace(), or ohash_delete(), yields
+   undefined behavior, whether done from ACTION or elsewhere. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action) {
+	size_t i;
+
+	ASSERT (action != NULL);
+
+	for (i = 0; i < h->slot_cnt; i++)
+		if (h->slots[i].elem != NULL)
+			action (h->slots[i].elem, h->aux);
+	for (i = 0; i < h->old_slot_cnt; i++)
+		if (h->old_slots[i].elem != NULL)
+			action (h->old_slots[i].elem, h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+   struct ohash_iterator i;
+
+   ohash_first (&i, h);
+   while (ohash_next (&i))
+   {
+   struct foo *f = ohash_entry (ohash_cur (&i), struct foo, elem);
+   ...do something with f...
+   }
+
+   Modifying hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h) {
+	ASSERT (i != NULL);
+	ASSERT (h != NULL);
+
+	i->hash = h;
+	i->slot = NULL;
+	i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order. */
+struct ohash_elem *
+ohash_next (struct ohash_iterator *i) {
+	struct ohash *h;
+	struct ohash_slot *s;
+	bool in_old;
+
+	ASSERT (i != NULL);
+
+	h = i->hash;
+	s = i->slot == NULL ? h->slots : i->slot + 1;
+	in_old = i->slot != NULL
+		&& slot_in (i->slot, h->old_slots, h->old_slot_cnt);
+	for (;;) {
+		if (!in_old && s == h->slots + h->slot_cnt) {
+			if (h->old_slots == NULL)
+				break;
+			s = h->old_slots;
+			in_old = true;
+		}
+		if (in_old && s == h->old_slots + h->old_slot_cnt)
+			break;
+		if (s->elem != NULL) {
+			i->slot = s;
+			i->elem = s->elem;
+			return i->elem;
+		}
+		s++;
+	}
+
+	/* Park on the last slot so that further calls keep
+	   returning a null pointer. */
+	i->slot = s - 1;
+	i->elem = NULL;
+	return NULL;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct ohash_elem *
+ohash_cur (struct ohash_iterator *i) {
+	return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h) {
+	return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h) {
+	return h->elem_cnt == 0;
+}
+
+/* Returns a zeroed array of SLOT_CNT slots, or a null pointer if
+   memory is exhausted. */
+static struct ohash_slot *
+alloc_slots (size_t slot_cnt) {
+	return calloc (slot_cnt, sizeof (struct ohash_slot));
+}
+
+/* Searches the SLOT_CNT slots at SLOTS for an element equal to
+   E, whose hash value must already be cached in E.  Returns its
+   slot if found or a null pointer otherwise.
+
+   Robin Hood insertion keeps every probe sequence ordered by
+   distance from home, so the search can stop at the first slot
+   whose occupant is closer to its own home than E would be.
+   Tombstones keep their probe length for exactly that reason. */
+static struct ohash_slot *
+find_slot (struct ohash *h, struct ohash_slot *slots, size_t slot_cnt,
+		struct ohash_elem *e) {
+	size_t mask = slot_cnt - 1;
+	size_t idx = e->hash & mask;
+	uint32_t tag = hash_tag (e->hash);
+	uint32_t psl;
+
+	for (psl = 1; psl <= slot_cnt; psl++) {
+		struct ohash_slot *s = &slots[idx];
+
+		if (s->psl < psl)
+			return NULL;
+		if (s->elem != NULL && s->hash == tag
+				&& !h->less (s->elem, e, h->aux)
+				&& !h->less (e, s->elem, h->aux))
+			return s;
+		idx = (idx + 1) & mask;
+	}
+	return NULL;
+}
+
+/* Searches both the current and, during a resize, the old table
+   of H for an element equal to E. */
+static struct ohash_slot *
+find_any (struct ohash *h, struct ohash_elem *e) {
+	struct ohash_slot *s = find_slot (h, h->slots, h->slot_cnt, e);
+	if (s == NULL && h->old_slots != NULL)
+		s = find_slot (h, h->old_slots, h->old_slot_cnt, e);
+	return s;
+}
+
+/* Inserts E, whose hash value must already be cached in E, into
+   the SLOT_CNT slots at SLOTS, which must have a free slot and
+   must not contain tombstones.  An element that is further from
+   its home slot takes the place of one that is nearer, which
+   then continues probing in its stead. */
+static void
+insert_slot (struct ohash_slot *slots, size_t slot_cnt,
+		struct ohash_elem *e) {
+	size_t mask = slot_cnt - 1;
+	size_t idx = e->hash & mask;
+	struct ohash_slot cur;
+
+	cur.hash = hash_tag (e->hash);
+	cur.psl = 1;
+	cur.elem = e;
+	for (;;) {
+		struct ohash_slot *s = &slots[idx];
+
+		if (s->psl == 0) {
+			*s = cur;
+			return;
+		}
+		if (s->psl < cur.psl) {
+			struct ohash_slot tmp = *s;
+			*s = cur;
+			cur = tmp;
+		}
+		idx = (idx + 1) & mask;
+		cur.psl++;
+	}
+}
+
+/* Removes the element in slot S from hash table H.
+
+   In the current table, later members of the probe sequence are
+   shifted back by one, so no tombstones accumulate.  The old
+   table is only ever drained during a resize, and shifting there
+   could move an element behind the migration cursor, so the slot
+   becomes a tombstone instead. */
+static void
+remove_slot (struct ohash *h, struct ohash_slot *s) {
+	h->elem_cnt--;
+
+	if (slot_in (s, h->old_slots, h->old_slot_cnt)) {
+		s->elem = NULL;
+		if (--h->old_elem_cnt == 0)
+			migrate (h, h->old_slot_cnt);
+		return;
+	}
+
+	size_t mask = h->slot_cnt - 1;
+	size_t idx = s - h->slots;
+	for (;;) {
+		size_t next = (idx + 1) & mask;
+		if (h->slots[next].psl <= 1) {
+			memset (&h->slots[idx], 0, sizeof h->slots[idx]);
+			return;
+		}
+		h->slots[idx] = h->slots[next];
+		h->slots[idx].psl--;
+		idx = next;
+	}
+}
+
+/* Moves the elements in up to SLOT_CNT slots of H's old table
+   into the current one, and frees the old table once it has been
+   drained. */
+static void
+migrate (struct ohash *h, size_t slot_cnt) {
+	if (h->old_slots == NULL)
+		return;
+
+	while (slot_cnt-- > 0 && h->old_elem_cnt > 0
+			&& h->migrate_idx < h->old_slot_cnt) {
+		struct ohash_slot *s = &h->old_slots[h->migrate_idx++];
+		if (s->elem != NULL) {
+			insert_slot (h->slots, h->slot_cnt, s->elem);
+			s->elem = NULL;
+			h->old_elem_cnt--;
+		}
+	}
+
+	if (h->old_elem_cnt == 0 || h->migrate_idx >= h->old_slot_cnt) {
+		ASSERT (h->old_elem_cnt == 0);
+		free (h->old_slots);
+		h->old_slots = NULL;
+		h->old_slot_cnt = 0;
+		h->migrate_idx = 0;
+	}
+}
+
+/* Makes room in hash table H for one more element.  If the table
+   would become too full, starts moving it to a table twice the
+   size; the move itself is spread over later operations by
+   migrate().  This can fail because of an out-of-memory
+   condition, which only makes the table fuller, unless it is
+   completely full. */
+static void
+grow (struct ohash *h) {
+	struct ohash_slot *new_slots;
+
+	if ((h->elem_cnt + 1) * MAX_LOAD_DEN <= h->slot_cnt * MAX_LOAD_NUM)
+		return;
+
+	/* A resize is already under way: finish it first.  This does
+	   not happen with MIGRATE_STEP at its current value. */
+	migrate (h, h->old_slot_cnt);
+
+	new_slots = alloc_slots (h->slot_cnt * 2);
+	if (new_slots == NULL) {
+		if (h->elem_cnt + 1 > h->slot_cnt)
+			PANIC ("ohash: table full and out of memory");
+		return;
+	}
+
+	h->old_slots = h->slots;
+	h->old_slot_cnt = h->slot_cnt;
+	h->old_elem_cnt = h->elem_cnt;
+	h->migrate_idx = 0;
+	h->slots = new_slots;
+	h->slot_cnt *= 2;
+}
@@ -127,10 +127,28 @@ archive_ordinary_file (const char *file_name, int file_fd,
   bool read_error = false;
   bool success = true;
   int file_size = filesize (file_fd);
+  int whole_size = file_size / 512 * 512;
 
   if (!write_header (file_name, '0', file_size, 0644, archive_fd, write_error))
     return false;
 
+  /* Copy whole blocks inside the kernel, then pad the last one
+     through a buffer. */
+  if (whole_size > 0)
+    {
+      if (copy_file_range (file_fd, -1, archive_fd, -1, whole_size)
+          != whole_size)
+        {
+          if (!*write_error) 
+            {
+              printf ("error writing archive\n");
+              *write_error = true; 
+            }
+          return false;
+        }
+      file_size -= whole_size;
+    }
+
   while (file_size > 0) 
     {
       static char buf[512];
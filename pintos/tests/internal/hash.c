@@ -0,0 +1,293 @@
+/* Test program and benchmark for lib/kernel/hash.c and
+   lib/kernel/ohash.c.
+
+   Fills both hash table implementations with page-aligned
+   virtual addresses, the way a supplemental page table is keyed,
+   checks that they agree, and reports how many insertions and
+   lookups per second each sustains at several table sizes.  Then
+   runs a random mix of insertions, replacements, and deletions
+   on both and checks that lookups and iteration keep agreeing
+   while ohash resizes underneath.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <ohash.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Largest table that we will benchmark. */
+#define MAX_CNT 16384
+
+/* Number of timer ticks each lookup benchmark runs for. */
+#define BENCH_TICKS (TIMER_FREQ / 2)
+
+/* Keys and operations used by the mixed cross-check. */
+#define MIXED_KEYS 2048
+#define MIXED_OPS 16384
+
+/* The mixed cross-check compares the whole tables this often. */
+#define MIXED_CHECK_INTERVAL 32
+
+/* A fake page, keyed by its virtual address. */
+struct fake_page
+  {
+    void *va;                   /* Key. */
+    struct hash_elem hash_elem; /* For struct hash. */
+    struct ohash_elem ohash_elem; /* For struct ohash. */
+    unsigned mark;              /* Last iteration that visited this. */
+  };
+
+static uint64_t page_hash (const struct hash_elem *, void *);
+static bool page_less (const struct hash_elem *, const struct hash_elem *,
+                       void *);
+static uint64_t page_ohash (const struct ohash_elem *, void *);
+static bool page_oless (const struct ohash_elem *, const struct ohash_elem *,
+                        void *);
+static void bench (struct fake_page *, size_t cnt);
+static void check_mixed (struct fake_page *);
+static void check_tables (struct hash *, struct ohash *,
+                          struct fake_page *, size_t key_cnt);
+
+/* Test and benchmark both hash table implementations. */
+void
+test (void)
+{
+  struct fake_page *pages = malloc (sizeof *pages * MAX_CNT);
+  size_t cnt, i;
+
+  ASSERT (pages != NULL);
+  for (i = 0; i < MAX_CNT; i++)
+    pages[i].va = (void *) (0x400000 + i * PGSIZE);
+
+  for (cnt = 64; cnt <= MAX_CNT; cnt *= 4)
+    bench (pages, cnt);
+
+  check_mixed (pages);
+
+  free (pages);
+  printf ("hash: PASS\n");
+}
+
+static uint64_t
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct fake_page *p = hash_entry (e, struct fake_page, hash_elem);
+  return hash_bytes (&p->va, sizeof p->va);
+}
+
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  return hash_entry (a, struct fake_page, hash_elem)->va
+         < hash_entry (b, struct fake_page, hash_elem)->va;
+}
+
+static uint64_t
+page_ohash (const struct ohash_elem *e, void *aux UNUSED)
+{
+  const struct fake_page *p = ohash_entry (e, struct fake_page, ohash_elem);
+  return hash_bytes (&p->va, sizeof p->va);
+}
+
+static bool
+page_oless (const struct ohash_elem *a, const struct ohash_elem *b,
+            void *aux UNUSED)
+{
+  return ohash_entry (a, struct fake_page, ohash_elem)->va
+         < ohash_entry (b, struct fake_page, ohash_elem)->va;
+}
+
+/* Inserts the first CNT of PAGES into a struct hash and a struct
+   ohash, verifies that lookups of present and absent keys agree,
+   and prints the time to build each table along with lookup
+   throughput. */
+static void
+bench (struct fake_page *pages, size_t cnt)
+{
+  struct hash h;
+  struct ohash oh;
+  unsigned long hash_finds = 0, ohash_finds = 0;
+  int64_t start, hash_build, ohash_build;
+  struct fake_page key;
+  size_t i;
+
+  ASSERT (hash_init (&h, page_hash, page_less, NULL));
+  ASSERT (ohash_init (&oh, page_ohash, page_oless, NULL));
+
+  start = timer_ticks ();
+  for (i = 0; i < cnt; i++)
+    ASSERT (hash_insert (&h, &pages[i].hash_elem) == NULL);
+  hash_build = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < cnt; i++)
+    ASSERT (ohash_insert (&oh, &pages[i].ohash_elem) == NULL);
+  ohash_build = timer_elapsed (start);
+
+  ASSERT (hash_size (&h) == cnt && ohash_size (&oh) == cnt);
+  for (i = 0; i < cnt * 2; i++)
+    {
+      key.va = (void *) (0x400000 + i * PGSIZE);
+      ASSERT ((hash_find (&h, &key.hash_elem) != NULL) == (i < cnt));
+      ASSERT ((ohash_find (&oh, &key.ohash_elem) != NULL) == (i < cnt));
+    }
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < BENCH_TICKS)
+    {
+      key.va = pages[random_ulong () % cnt].va;
+      hash_find (&h, &key.hash_elem);
+      hash_finds++;
+    }
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < BENCH_TICKS)
+    {
+      key.va = pages[random_ulong () % cnt].va;
+      ohash_find (&oh, &key.ohash_elem);
+      ohash_finds++;
+    }
+
+  printf ("%zu pages: build %lld/%lld ticks, "
+          "%lu/%lu finds/s (hash/ohash)\n",
+          cnt, hash_build, ohash_build,
+          hash_finds * TIMER_FREQ / BENCH_TICKS,
+          ohash_finds * TIMER_FREQ / BENCH_TICKS);
+
+  hash_destroy (&h, NULL);
+  ohash_destroy (&oh, NULL);
+}
+
+/* Runs MIXED_OPS random insertions, replacements, and deletions
+   over MIXED_KEYS keys on a struct hash and a struct ohash in
+   lockstep.  PAGES holds two elements per key, at I and
+   I + MIXED_KEYS, so that replacing and inserting can offer an
+   element that is equal to but not the same as the one already
+   in the table.  The mix starts out insertion-heavy, so that
+   ohash grows several times, then turns deletion-heavy to drain
+   it, and every kind of operation must land at least once while
+   a resize is under way. */
+static void
+check_mixed (struct fake_page *pages)
+{
+  struct hash h;
+  struct ohash oh;
+  size_t migrating[3] = {0, 0, 0};
+  size_t i;
+
+  ASSERT (MIXED_KEYS * 2 <= MAX_CNT);
+  for (i = 0; i < MIXED_KEYS * 2; i++)
+    {
+      pages[i].va = (void *) (0x400000 + i % MIXED_KEYS * PGSIZE);
+      pages[i].mark = 0;
+    }
+
+  ASSERT (hash_init (&h, page_hash, page_less, NULL));
+  ASSERT (ohash_init (&oh, page_ohash, page_oless, NULL));
+
+  for (i = 0; i < MIXED_OPS; i++)
+    {
+      size_t k = random_ulong () % MIXED_KEYS;
+      struct fake_page *p = &pages[k + random_ulong () % 2 * MIXED_KEYS];
+      bool draining = i >= MIXED_OPS / 2;
+      unsigned op = random_ulong () % 8;
+      bool in_resize = oh.old_slots != NULL;
+      struct hash_elem *he;
+      struct ohash_elem *oe;
+
+      /* 5/8 insert, 1/8 replace, 2/8 delete while filling;
+         2/8 insert, 1/8 replace, 5/8 delete while draining. */
+      if (op < (draining ? 2 : 5))
+        {
+          he = hash_insert (&h, &p->hash_elem);
+          oe = ohash_insert (&oh, &p->ohash_elem);
+          op = 0;
+        }
+      else if (op < (draining ? 3u : 6u))
+        {
+          he = hash_replace (&h, &p->hash_elem);
+          oe = ohash_replace (&oh, &p->ohash_elem);
+          op = 1;
+        }
+      else
+        {
+          struct fake_page key;
+          key.va = p->va;
+          he = hash_delete (&h, &key.hash_elem);
+          oe = ohash_delete (&oh, &key.ohash_elem);
+          op = 2;
+        }
+
+      ASSERT ((he == NULL) == (oe == NULL));
+      ASSERT (he == NULL
+              || hash_entry (he, struct fake_page, hash_elem)
+                 == ohash_entry (oe, struct fake_page, ohash_elem));
+      ASSERT (hash_size (&h) == ohash_size (&oh));
+      if (in_resize)
+        migrating[op]++;
+
+      if (i % MIXED_CHECK_INTERVAL == 0 || in_resize != (oh.old_slots != NULL))
+        check_tables (&h, &oh, pages, MIXED_KEYS);
+    }
+  check_tables (&h, &oh, pages, MIXED_KEYS);
+
+  printf ("mixed: %zu inserts, %zu replaces, %zu deletes during resize\n",
+          migrating[0], migrating[1], migrating[2]);
+  ASSERT (migrating[0] > 0 && migrating[1] > 0 && migrating[2] > 0);
+
+  hash_destroy (&h, NULL);
+  ohash_destroy (&oh, NULL);
+}
+
+/* Checks that H and OH hold exactly the same elements: every
+   key of the first KEY_CNT in PAGES finds the same element in
+   both, and iterating OH visits each of its elements exactly
+   once, all of them in H. */
+static void
+check_tables (struct hash *h, struct ohash *oh, struct fake_page *pages,
+              size_t key_cnt)
+{
+  static unsigned mark;
+  struct ohash_iterator it;
+  struct fake_page key;
+  size_t i, cnt = 0;
+
+  for (i = 0; i < key_cnt; i++)
+    {
+      struct hash_elem *he;
+      struct ohash_elem *oe;
+
+      key.va = pages[i].va;
+      he = hash_find (h, &key.hash_elem);
+      oe = ohash_find (oh, &key.ohash_elem);
+      ASSERT ((he == NULL) == (oe == NULL));
+      ASSERT (he == NULL
+              || hash_entry (he, struct fake_page, hash_elem)
+                 == ohash_entry (oe, struct fake_page, ohash_elem));
+    }
+
+  mark++;
+  ohash_first (&it, oh);
+  while (ohash_next (&it))
+    {
+      struct fake_page *p = ohash_entry (ohash_cur (&it), struct fake_page,
+                                         ohash_elem);
+      ASSERT (p->mark != mark);
+      p->mark = mark;
+      key.va = p->va;
+      ASSERT (hash_find (h, &key.hash_elem) == &p->hash_elem);
+      cnt++;
+    }
+  ASSERT (ohash_cur (&it) == NULL && ohash_next (&it) == NULL);
+  ASSERT (cnt == ohash_size (oh) && cnt == hash_size (h));
+}
@@ -0,0 +1,53 @@
+/* A child writes several times more than the pipe holds in a
+   single write(), so it has to block until the parent drains the
+   pipe, and the parent's reads block whenever the pipe is empty.
+   Checks that every byte arrives in order and that the parent
+   sees end of file once the child has exited. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 1024 + 123)
+#define CHUNK 1000
+
+static char buf[SIZE];
+
+void
+test_main (void) 
+{
+  char chunk[CHUNK];
+  size_t got = 0;
+  int fds[2];
+  pid_t pid;
+  int n, i;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i % 251;
+
+  if ((pid = fork ("child")) == 0)
+    {
+      close (fds[0]);
+      if (write (fds[1], buf, SIZE) != SIZE)
+        fail ("child: short write");
+      exit (0);
+    }
+
+  close (fds[1]);
+  while ((n = read (fds[0], chunk, CHUNK)) > 0)
+    {
+      for (i = 0; i < n; i++)
+        if (chunk[i] != (char) ((got + i) % 251))
+          fail ("byte %zu is %d", got + i, chunk[i]);
+      got += n;
+    }
+  if (n < 0)
+    fail ("read returned %d", n);
+
+  if (wait (pid) != 0)
+    fail ("child exited with an error");
+  if (got != SIZE)
+    fail ("read %zu bytes instead of %d", got, SIZE);
+  msg ("read all bytes in order, then end of file");
+}
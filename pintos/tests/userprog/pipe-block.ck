@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-block) begin
+(pipe-block) pipe
+child: exit(0)
+(pipe-block) read all bytes in order, then end of file
+(pipe-block) end
+pipe-block: exit(0)
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Moves the write end of a pipe to fd 20 and the read end onto
+   stdin with dup2(), closing the originals.  The duplicates must
+   keep the pipe open and work through fork, and the parent must
+   see end of file only once the child's copy of fd 20 is gone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+  size_t got = 0;
+  int fds[2];
+  pid_t pid;
+  int n;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (dup2 (fds[1], 20) == 20, "dup2 write end to fd 20");
+  close (fds[1]);
+  CHECK (write (20, "abc", 3) == 3, "write through fd 20");
+  CHECK (dup2 (fds[0], 0) == 0, "dup2 read end to stdin");
+  close (fds[0]);
+  CHECK (read (0, buf, sizeof buf) == 3 && !memcmp (buf, "abc", 3),
+         "read through stdin");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      close (0);
+      write (20, "def", 3);
+      exit (0);
+    }
+
+  close (20);
+  while ((n = read (0, buf + got, sizeof buf - got)) > 0)
+    got += n;
+
+  if (wait (pid) != 0)
+    fail ("child exited with an error");
+  if (got != 3 || memcmp (buf, "def", 3))
+    fail ("read %zu bytes from child", got);
+  msg ("child's fd 20 kept the pipe open until it exited");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-dup2) begin
+(pipe-dup2) pipe
+(pipe-dup2) dup2 write end to fd 20
+(pipe-dup2) write through fd 20
+(pipe-dup2) dup2 read end to stdin
+(pipe-dup2) read through stdin
+child: exit(0)
+(pipe-dup2) child's fd 20 kept the pipe open until it exited
+(pipe-dup2) end
+pipe-dup2: exit(0)
+EOF
+pass;
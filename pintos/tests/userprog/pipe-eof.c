@@ -0,0 +1,52 @@
+/* Parent and child both hold the write end of a pipe.  After the
+   parent closes its copy, read() must still wait for the child,
+   which writes a second message only when told to over another
+   pipe, and must report end of file only after the child's copy
+   is closed too. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char expected[] = "hello, world";
+  char buf[64];
+  int data[2], go[2];
+  size_t got = 0;
+  pid_t pid;
+  int n;
+
+  CHECK (pipe (data) == 0, "pipe for data");
+  CHECK (pipe (go) == 0, "pipe for go-ahead");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      char c;
+
+      close (data[0]);
+      close (go[1]);
+      write (data[1], "hello", 5);
+      if (read (go[0], &c, 1) != 1)
+        fail ("child: no go-ahead");
+      write (data[1], ", world", 7);
+      exit (0);
+    }
+
+  close (data[1]);
+  close (go[0]);
+  while (got < 5 && (n = read (data[0], buf + got, 5 - got)) > 0)
+    got += n;
+  write (go[1], "g", 1);
+  while ((n = read (data[0], buf + got, sizeof buf - got - 1)) > 0)
+    got += n;
+  buf[got] = '\0';
+
+  if (wait (pid) != 0)
+    fail ("child exited with an error");
+  if (strcmp (buf, expected))
+    fail ("read \"%s\" before end of file instead of \"%s\"", buf, expected);
+  msg ("end of file only after both writers closed");
+}
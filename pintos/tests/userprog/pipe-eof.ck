@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-eof) begin
+(pipe-eof) pipe for data
+(pipe-eof) pipe for go-ahead
+child: exit(0)
+(pipe-eof) end of file only after both writers closed
+(pipe-eof) end
+pipe-eof: exit(0)
+EOF
+pass;
@@ -0,0 +1,39 @@
+/* Hands a message from parent to child over one pipe and a reply
+   back over another, so each side blocks in read() until the
+   other has written. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int down[2], up[2];
+  char buf[16];
+  pid_t pid;
+
+  CHECK (pipe (down) == 0, "pipe to child");
+  CHECK (pipe (up) == 0, "pipe to parent");
+
+  if ((pid = fork ("child")) == 0)
+    {
+      close (down[1]);
+      close (up[0]);
+      if (read (down[0], buf, sizeof buf) != 5 || memcmp (buf, "ping", 5))
+        fail ("child: did not get ping");
+      write (up[1], "pong", 5);
+      exit (0);
+    }
+
+  close (down[0]);
+  close (up[1]);
+  write (down[1], "ping", 5);
+  if (read (up[0], buf, sizeof buf) != 5 || memcmp (buf, "pong", 5))
+    fail ("parent: did not get pong");
+
+  if (wait (pid) != 0)
+    fail ("child exited with an error");
+  msg ("ping went down and pong came back");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-fork) begin
+(pipe-fork) pipe to child
+(pipe-fork) pipe to parent
+child: exit(0)
+(pipe-fork) ping went down and pong came back
+(pipe-fork) end
+pipe-fork: exit(0)
+EOF
+pass;
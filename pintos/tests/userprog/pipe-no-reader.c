@@ -0,0 +1,22 @@
+/* Writing into a pipe whose read ends have all been closed, in
+   this process and in a child that exits, must fail with -1
+   instead of blocking. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  if ((pid = fork ("child")) == 0)
+    exit (0);
+  close (fds[0]);
+  if (wait (pid) != 0)
+    fail ("child exited with an error");
+  CHECK (write (fds[1], "x", 1) == -1, "write with no reader returns -1");
+}
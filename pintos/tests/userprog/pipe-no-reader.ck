@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-no-reader) begin
+(pipe-no-reader) pipe
+child: exit(0)
+(pipe-no-reader) write with no reader returns -1
+(pipe-no-reader) end
+pipe-no-reader: exit(0)
+EOF
+pass;
@@ -0,0 +1,32 @@
+/* Writes into a pipe and reads the bytes back in the same
+   process, then closes the write end and checks that read()
+   reports end of file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char text[] = "pipes carry bytes";
+  char buf[64];
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (fds[0] > 1 && fds[1] > 1 && fds[0] != fds[1],
+         "pipe returned two new fds");
+  CHECK (write (fds[1], text, sizeof text) == (int) sizeof text,
+         "write into write end");
+  CHECK (write (fds[0], text, sizeof text) == -1,
+         "write into read end fails");
+  CHECK (read (fds[0], buf, sizeof buf) == (int) sizeof text,
+         "read from read end");
+  if (memcmp (buf, text, sizeof text))
+    fail ("read back \"%s\" instead of \"%s\"", buf, text);
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == 0,
+         "read after write end closed returns 0");
+  close (fds[0]);
+}
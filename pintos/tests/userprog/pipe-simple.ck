@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-simple) begin
+(pipe-simple) pipe
+(pipe-simple) pipe returned two new fds
+(pipe-simple) write into write end
+(pipe-simple) write into read end fails
+(pipe-simple) read from read end
+(pipe-simple) read after write end closed returns 0
+(pipe-simple) end
+pipe-simple: exit(0)
+EOF
+pass;
@@ -0,0 +1,21 @@
+/* Child process for shm-key.
+   Attaches the parent's key at another address, checks what the
+   parent wrote, and answers in the second half of the page. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define KEY 42
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x20000000;
+
+  CHECK (shm_attach (KEY, 4096, shared) == shared, "attach key %d", KEY);
+  CHECK (!strcmp (shared, "written by the parent"),
+         "parent's write is visible");
+  strlcpy (shared + 2048, "written by the child", 2048);
+}
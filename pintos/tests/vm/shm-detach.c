@@ -0,0 +1,32 @@
+/* Detaches a shared memory object.  Only the start of an attachment
+   can be detached, detaching the last mapping discards the contents,
+   and the detached range is inaccessible afterward. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define KEY 7
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+
+  CHECK (shm_attach (KEY, 2 * 4096, shared) == shared, "attach key %d", KEY);
+  shared[0] = 'x';
+  shared[4096] = 'y';
+
+  CHECK (!shm_detach (shared + 4096), "detach from the middle fails");
+  CHECK (!shm_detach ((char *) 0x20000000), "detach of unmapped memory fails");
+  CHECK (shm_detach (shared), "detach key %d", KEY);
+  CHECK (!shm_detach (shared), "second detach fails");
+
+  CHECK (shm_attach (KEY, 2 * 4096, shared) == shared,
+         "attach key %d again", KEY);
+  CHECK (shared[0] == 0 && shared[4096] == 0,
+         "last detach discarded the old contents");
+  CHECK (shm_detach (shared), "detach key %d", KEY);
+
+  fail ("detached memory is readable (%d)", shared[4096]);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-detach) begin
+(shm-detach) attach key 7
+(shm-detach) detach from the middle fails
+(shm-detach) detach of unmapped memory fails
+(shm-detach) detach key 7
+(shm-detach) second detach fails
+(shm-detach) attach key 7 again
+(shm-detach) last detach discarded the old contents
+(shm-detach) detach key 7
+shm-detach: exit(-1)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Attaches an unnamed shared memory object and forks.  The child
+   must share the parent's pages rather than get copies, including
+   a page that neither process had touched before the fork. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  pid_t child;
+
+  CHECK (shm_attach (-1, 3 * 4096, shared) == shared,
+         "attach unnamed object");
+  shared[0] = 'p';
+  shared[4096] = 'p';
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      if (shared[0] != 'p' || shared[4096] != 'p')
+        fail ("child does not see the parent's data");
+      shared[4096] = 'c';
+      shared[2 * 4096] = 'c';
+      exit (0);
+    }
+
+  quiet = true;
+  CHECK (wait (child) == 0, "wait for child");
+  quiet = false;
+
+  CHECK (shared[0] == 'p' && shared[4096] == 'c' && shared[2 * 4096] == 'c',
+         "child's writes are visible in the parent");
+}
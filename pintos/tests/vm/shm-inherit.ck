@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-inherit) begin
+(shm-inherit) attach unnamed object
+child: exit(0)
+(shm-inherit) child's writes are visible in the parent
+(shm-inherit) end
+shm-inherit: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Attaches a shared memory object by key and runs child-shm, which
+   attaches the same key at a different address.  Each process must
+   see what the other wrote. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define KEY 42
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  pid_t child;
+
+  CHECK (shm_attach (KEY, 4096, shared) == shared, "attach key %d", KEY);
+  strlcpy (shared, "written by the parent", 2048);
+
+  child = fork ("child-shm");
+  if (child == 0)
+    CHECK (exec ("child-shm") != -1, "exec \"child-shm\"");
+
+  quiet = true;
+  CHECK (wait (child) == 0, "wait for child");
+  quiet = false;
+
+  CHECK (!strcmp (shared + 2048, "written by the child"),
+         "child's write is visible");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-key) begin
+(shm-key) attach key 42
+(shm-key) exec "child-shm"
+(child-shm) begin
+(child-shm) attach key 42
+(child-shm) parent's write is visible
+(child-shm) end
+child-shm: exit(0)
+(shm-key) child's write is visible
+(shm-key) end
+shm-key: exit(0)
+EOF
+pass;
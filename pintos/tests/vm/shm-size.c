@@ -0,0 +1,27 @@
+/* Attaching an existing key with a size that covers a different
+   number of pages must fail and leave the object alone. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define KEY 9
+
+void
+test_main (void)
+{
+  char *first = (char *) 0x10000000;
+  char *second = (char *) 0x20000000;
+
+  CHECK (shm_attach (KEY, 2 * 4096, first) == first,
+         "attach key %d with two pages", KEY);
+  first[0] = 'k';
+
+  CHECK (shm_attach (KEY, 4096, second) == NULL,
+         "attach key %d with one page fails", KEY);
+  CHECK (shm_attach (KEY, 3 * 4096, second) == NULL,
+         "attach key %d with three pages fails", KEY);
+  CHECK (shm_attach (KEY, 2 * 4096 - 100, second) == second,
+         "attach key %d with a size that rounds to two pages", KEY);
+  CHECK (second[0] == 'k', "both attachments share the object");
+}
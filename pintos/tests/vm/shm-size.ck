@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-size) begin
+(shm-size) attach key 9 with two pages
+(shm-size) attach key 9 with one page fails
+(shm-size) attach key 9 with three pages fails
+(shm-size) attach key 9 with a size that rounds to two pages
+(shm-size) both attachments share the object
+(shm-size) end
+shm-size: exit(0)
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Fills a shared memory object larger than the user pool, then forks
+   a child that checks and rewrites every page.  Pages of the object
+   are evicted and swapped back in while both processes map them.
+   For this test, Pintos memory size is 10MB. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define SHM_SIZE (8 * ONE_MB)
+#define PAGE_COUNT (SHM_SIZE / PAGE_SIZE)
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  pid_t child;
+  size_t i;
+
+  CHECK (shm_attach (-1, SHM_SIZE, shared) == shared,
+         "attach 8 MB unnamed object");
+
+  msg ("fill every page");
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      shared[i * PAGE_SIZE] = (char) i;
+      shared[i * PAGE_SIZE + PAGE_SIZE - 1] = (char) ~i;
+    }
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      for (i = 0; i < PAGE_COUNT; i++)
+        {
+          if (shared[i * PAGE_SIZE] != (char) i
+              || shared[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) ~i)
+            fail ("child read bad data in page %zu", i);
+          shared[i * PAGE_SIZE] = (char) (i + 1);
+        }
+      exit (0);
+    }
+
+  quiet = true;
+  CHECK (wait (child) == 0, "wait for child");
+  quiet = false;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (shared[i * PAGE_SIZE] != (char) (i + 1)
+        || shared[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) ~i)
+      fail ("parent read bad data in page %zu", i);
+  msg ("child's writes survived eviction");
+}
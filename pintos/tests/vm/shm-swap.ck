@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-swap) begin
+(shm-swap) attach 8 MB unnamed object
+(shm-swap) fill every page
+child: exit(0)
+(shm-swap) child's writes survived eviction
+(shm-swap) end
+shm-swap: exit(0)
+EOF
+pass;
@@ -218,6 +218,10 @@ parse_options (char **argv) {
 #ifdef FILESYS
 		else if (!strcmp (name, "-f"))
 			format_filesys = true;
+		else if (!strcmp (name, "-ds")) {
+			if (value == NULL || !disk_set_scheduler (value))
+				PANIC ("unknown disk scheduler `%s'", value ? value : "");
+		}
 #endif
 		else if (!strcmp (name, "-rs"))
 			random_init (atoi (value));
@@ -327,6 +331,10 @@ usage (void) {
 			"  -h                 Print this help message and power off.\n"
 			"  -q                 Power off VM after actions or on panic.\n"
 			"  -f                 Format file system disk during startup.\n"
+#ifdef FILESYS
+			"  -ds=SCHED          Schedule disk requests with fifo, clook\n"
+			"                     or deadline (default clook).\n"
+#endif
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
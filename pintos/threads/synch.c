@@ -392,3 +392,100 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 	while (!list_empty (&cond->waiters))
 		cond_signal (cond, lock);
 }
+
+/* Initializes RWLOCK.  Any number of threads may hold a
+   readers-writer lock for reading at the same time, but a thread
+   holding it for writing excludes everyone else.
+
+   Writers are preferred: once a writer is waiting, new readers
+   wait behind it, so a steady stream of readers cannot starve
+   writers. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	cond_init (&rw->can_read);
+	cond_init (&rw->can_write);
+	rw->readers = 0;
+	rw->waiting_writers = 0;
+	rw->writer = NULL;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or is
+   waiting for it.  Read acquisitions do not nest if a writer may
+   arrive in between, so a thread must not acquire RW for reading
+   twice.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != thread_current ());
+
+	lock_acquire (&rw->lock);
+	while (rw->writer != NULL || rw->waiting_writers > 0)
+		cond_wait (&rw->can_read, &rw->lock);
+	rw->readers++;
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_acquire (&rw->lock);
+	ASSERT (rw->readers > 0);
+	if (--rw->readers == 0)
+		cond_signal (&rw->can_write, &rw->lock);
+	lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+	ASSERT (rw->writer != thread_current ());
+
+	lock_acquire (&rw->lock);
+	rw->waiting_writers++;
+	while (rw->writer != NULL || rw->readers > 0)
+		cond_wait (&rw->can_write, &rw->lock);
+	rw->waiting_writers--;
+	rw->writer = thread_current ();
+	lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for writing.
+   Hands the lock to the next writer if there is one, otherwise
+   lets every waiting reader in. */
+void
+rwlock_release_write (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_held_for_write (rw));
+
+	lock_acquire (&rw->lock);
+	rw->writer = NULL;
+	if (rw->waiting_writers > 0)
+		cond_signal (&rw->can_write, &rw->lock);
+	else
+		cond_broadcast (&rw->can_read, &rw->lock);
+	lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return rw->writer == thread_current ();
+}
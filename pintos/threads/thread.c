@@ -286,6 +286,8 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+	/* process_exit 의 write-back 도 바운스 버퍼를 쓸 수 있으므로 그 뒤에 해제. */
+	palloc_free_page (thread_current ()->fs_bounce);
 
 	/* 상태를 dying으로 설정하고 다른 프로세스를 스케줄.
 	   schedule_tail() 호출 중에 소멸될 것임. */
@@ -0,0 +1,136 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* 처음 크기. 비트맵 워드 하나. */
+#define FD_TABLE_MIN 64
+
+#define WORD_BITS 64
+
+static bool fd_table_grow (struct fd_table *, int fd);
+
+/* 0, 1 을 넣을 수 있는 빈 테이블을 만든다. 메모리가 없으면 false. */
+bool
+fd_table_init (struct fd_table *t) {
+	t->fds = calloc (FD_TABLE_MIN, sizeof *t->fds);
+	t->used = calloc (FD_TABLE_MIN / WORD_BITS, sizeof *t->used);
+	t->cap = FD_TABLE_MIN;
+	if (t->fds == NULL || t->used == NULL) {
+		fd_table_destroy (t);
+		return false;
+	}
+	return true;
+}
+
+/* 테이블 메모리만 놓는다. 열린 fd 는 호출자가 먼저 닫아야 한다.
+ * 만들어지지 않은 (0 으로 채워진) 테이블에도 불러도 된다. */
+void
+fd_table_destroy (struct fd_table *t) {
+	free (t->fds);
+	free (t->used);
+	t->fds = NULL;
+	t->used = NULL;
+	t->cap = 0;
+}
+
+struct file_descriptor *
+fd_table_get (const struct fd_table *t, int fd) {
+	if (fd < 0 || fd >= t->cap)
+		return NULL;
+	return t->fds[fd];
+}
+
+/* WRAP_FD 를 MIN_FD 이상인 가장 작은 빈 fd 에 넣고 그 번호를 돌려준다.
+ * MAX_FD 까지 다 찼거나 테이블을 늘릴 수 없으면 -1. */
+int
+fd_table_install (struct fd_table *t, int min_fd, struct file_descriptor *wrap_fd) {
+	int fd = min_fd;
+
+	ASSERT (wrap_fd != NULL);
+	while (fd < t->cap) {
+		/* 빈 칸이 1 이 되도록 뒤집는다. 밀려 들어오는 0 은 '사용 중' 이라
+		 * 워드 끝을 넘어가지 않는다. */
+		uint64_t free_bits = ~t->used[fd / WORD_BITS] >> (fd % WORD_BITS);
+		if (free_bits != 0) {
+			fd += __builtin_ctzll (free_bits);
+			break;
+		}
+		fd = (fd / WORD_BITS + 1) * WORD_BITS;
+	}
+
+	if (!fd_table_set (t, fd, wrap_fd))
+		return -1;
+	return fd;
+}
+
+/* FD 자리에 WRAP_FD 를 넣는다. 원래 있던 것은 호출자가 먼저 닫아야
+ * 한다. FD 가 MAX_FD 를 넘거나 테이블을 늘릴 수 없으면 false. */
+bool
+fd_table_set (struct fd_table *t, int fd, struct file_descriptor *wrap_fd) {
+	ASSERT (wrap_fd != NULL);
+	if (fd < 0 || (fd >= t->cap && !fd_table_grow (t, fd)))
+		return false;
+
+	t->fds[fd] = wrap_fd;
+	t->used[fd / WORD_BITS] |= (uint64_t) 1 << (fd % WORD_BITS);
+	return true;
+}
+
+/* FD 를 비우고 있던 것을 돌려준다. 닫지는 않는다. */
+struct file_descriptor *
+fd_table_remove (struct fd_table *t, int fd) {
+	struct file_descriptor *wrap_fd = fd_table_get (t, fd);
+
+	if (wrap_fd != NULL) {
+		t->fds[fd] = NULL;
+		t->used[fd / WORD_BITS] &= ~((uint64_t) 1 << (fd % WORD_BITS));
+	}
+	return wrap_fd;
+}
+
+/* FD 보다 큰 열린 fd 중 가장 작은 것, 없으면 -1.
+ * for (fd = fd_table_next (t, -1); fd >= 0; fd = fd_table_next (t, fd))
+ * 처럼 순회하면 빈 워드는 한 번에 건너뛴다. */
+int
+fd_table_next (const struct fd_table *t, int fd) {
+	fd++;
+	while (fd < t->cap) {
+		uint64_t used_bits = t->used[fd / WORD_BITS] >> (fd % WORD_BITS);
+		if (used_bits != 0)
+			return fd + __builtin_ctzll (used_bits);
+		fd = (fd / WORD_BITS + 1) * WORD_BITS;
+	}
+	return -1;
+}
+
+/* FD 가 들어가도록 테이블을 두 배씩 늘린다. */
+static bool
+fd_table_grow (struct fd_table *t, int fd) {
+	struct file_descriptor **fds;
+	uint64_t *used;
+	int cap = t->cap > 0 ? t->cap : FD_TABLE_MIN;
+
+	if (fd >= MAX_FD)
+		return false;
+	while (cap <= fd)
+		cap *= 2;
+	if (cap > MAX_FD)
+		cap = MAX_FD;
+
+	fds = realloc (t->fds, cap * sizeof *fds);
+	if (fds == NULL)
+		return false;
+	t->fds = fds;
+	used = realloc (t->used, cap / WORD_BITS * sizeof *used);
+	if (used == NULL)
+		return false;
+	t->used = used;
+
+	memset (fds + t->cap, 0, (cap - t->cap) * sizeof *fds);
+	memset (used + t->cap / WORD_BITS, 0,
+			(cap - t->cap) / WORD_BITS * sizeof *used);
+	t->cap = cap;
+	return true;
+}
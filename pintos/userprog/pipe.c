@@ -0,0 +1,208 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* 링 버퍼 크기. 페이지 하나. */
+#define PIPE_SIZE PGSIZE
+
+/* 익명 파이프.
+ *
+ * head 는 쓴 바이트 누적, tail 은 읽은 바이트 누적이라 head - tail 이
+ * 버퍼에 남은 양이다. head 는 쓰는 쪽만, tail 은 읽는 쪽만 옮기고
+ * 같은 쪽끼리는 read_lock / write_lock 으로 줄을 세우므로, 데이터가
+ * 있거나 자리가 있는 동안은 양쪽이 서로의 락 없이 진행한다 (SPSC).
+ * 데이터를 다 옮긴 뒤에 head/tail 을 옮겨야 상대가 덜 쓴 바이트를
+ * 보지 않는다. 단일 CPU 라 컴파일러 barrier 로 순서가 충분하다.
+ *
+ * 상대를 기다려야 할 때만 lock 을 잡고 cond 에서 잔다. 자기 전에
+ * *_waiting 을 세우고 다시 확인하므로, 상대는 head/tail 을 옮긴 뒤
+ * 이 플래그가 설 때만 lock 을 잡고 깨우면 된다. */
+struct pipe {
+	uint8_t *buf;                   /* PIPE_SIZE 바이트 링 버퍼. */
+	size_t head;                    /* 지금까지 쓴 바이트 수. */
+	size_t tail;                    /* 지금까지 읽은 바이트 수. */
+
+	struct lock read_lock;          /* 읽는 쪽끼리 직렬화. */
+	struct lock write_lock;         /* 쓰는 쪽끼리 직렬화. */
+
+	struct lock lock;               /* 아래 필드 보호. */
+	int readers;                    /* 열린 읽기 끝 수. */
+	int writers;                    /* 열린 쓰기 끝 수. */
+	bool reader_waiting;            /* 읽는 쪽이 readable 에서 자는 중? */
+	bool writer_waiting;            /* 쓰는 쪽이 writable 에서 자는 중? */
+	struct condition readable;      /* 데이터가 생기거나 쓰기 끝이 닫힘. */
+	struct condition writable;      /* 자리가 생기거나 읽기 끝이 닫힘. */
+};
+
+/* 읽기 끝과 쓰기 끝이 하나씩 열린 빈 파이프를 만든다.
+ * 메모리가 없으면 NULL. */
+struct pipe *
+pipe_create (void) {
+	struct pipe *p = malloc (sizeof *p);
+	if (p == NULL)
+		return NULL;
+	p->buf = palloc_get_page (0);
+	if (p->buf == NULL) {
+		free (p);
+		return NULL;
+	}
+	p->head = p->tail = 0;
+	lock_init (&p->read_lock);
+	lock_init (&p->write_lock);
+	lock_init (&p->lock);
+	p->readers = p->writers = 1;
+	p->reader_waiting = p->writer_waiting = false;
+	cond_init (&p->readable);
+	cond_init (&p->writable);
+	return p;
+}
+
+/* fork 한 자식처럼 P 의 끝을 하나 더 연다. */
+void
+pipe_open_end (struct pipe *p, bool write_end) {
+	lock_acquire (&p->lock);
+	if (write_end)
+		p->writers++;
+	else
+		p->readers++;
+	lock_release (&p->lock);
+}
+
+/* P 의 끝을 하나 닫고 반대쪽에서 자는 스레드를 깨운다.
+ * 양쪽 끝이 모두 닫히면 P 를 해제한다. */
+void
+pipe_close_end (struct pipe *p, bool write_end) {
+	bool dead;
+
+	lock_acquire (&p->lock);
+	if (write_end) {
+		ASSERT (p->writers > 0);
+		p->writers--;
+		cond_broadcast (&p->readable, &p->lock);
+	} else {
+		ASSERT (p->readers > 0);
+		p->readers--;
+		cond_broadcast (&p->writable, &p->lock);
+	}
+	dead = p->readers == 0 && p->writers == 0;
+	lock_release (&p->lock);
+
+	if (dead) {
+		palloc_free_page (p->buf);
+		free (p);
+	}
+}
+
+/* 링 버퍼의 누적 위치 POS 부터 SIZE 바이트를 BUFFER 로 복사한다. */
+static void
+ring_copy_out (const struct pipe *p, size_t pos, uint8_t *buffer, size_t size) {
+	size_t ofs = pos % PIPE_SIZE;
+	size_t first = size < PIPE_SIZE - ofs ? size : PIPE_SIZE - ofs;
+
+	memcpy (buffer, p->buf + ofs, first);
+	memcpy (buffer + first, p->buf, size - first);
+}
+
+/* BUFFER 의 SIZE 바이트를 링 버퍼의 누적 위치 POS 부터 복사한다. */
+static void
+ring_copy_in (struct pipe *p, size_t pos, const uint8_t *buffer, size_t size) {
+	size_t ofs = pos % PIPE_SIZE;
+	size_t first = size < PIPE_SIZE - ofs ? size : PIPE_SIZE - ofs;
+
+	memcpy (p->buf + ofs, buffer, first);
+	memcpy (p->buf, buffer + first, size - first);
+}
+
+/* P 에서 최대 SIZE 바이트를 BUFFER 로 읽는다. 데이터가 없으면 생길
+ * 때까지 기다리고, 그 사이 쓰기 끝이 모두 닫히면 0 (파일 끝).
+ * 읽은 바이트 수를 돌려준다. */
+int
+pipe_read (struct pipe *p, void *buffer, unsigned size) {
+	size_t avail;
+
+	if (size == 0)
+		return 0;
+
+	lock_acquire (&p->read_lock);
+	barrier ();
+	avail = p->head - p->tail;
+	if (avail == 0) {
+		lock_acquire (&p->lock);
+		p->reader_waiting = true;
+		barrier ();
+		while ((avail = p->head - p->tail) == 0 && p->writers > 0)
+			cond_wait (&p->readable, &p->lock);
+		p->reader_waiting = false;
+		lock_release (&p->lock);
+		if (avail == 0) {
+			lock_release (&p->read_lock);
+			return 0;
+		}
+	}
+
+	if (avail > size)
+		avail = size;
+	ring_copy_out (p, p->tail, buffer, avail);
+	barrier ();
+	p->tail += avail;
+	barrier ();
+
+	if (p->writer_waiting) {
+		lock_acquire (&p->lock);
+		cond_signal (&p->writable, &p->lock);
+		lock_release (&p->lock);
+	}
+	lock_release (&p->read_lock);
+	return avail;
+}
+
+/* BUFFER 의 SIZE 바이트를 모두 P 에 쓴다. 자리가 없으면 날 때까지
+ * 기다린다. 읽기 끝이 모두 닫히면 거기서 멈추고 그때까지 쓴 바이트
+ * 수를, 하나도 못 썼으면 -1 을 돌려준다. */
+int
+pipe_write (struct pipe *p, const void *buffer_, unsigned size) {
+	const uint8_t *buffer = buffer_;
+	size_t written = 0;
+
+	lock_acquire (&p->write_lock);
+	while (written < size) {
+		size_t space, n;
+
+		barrier ();
+		space = PIPE_SIZE - (p->head - p->tail);
+		if (space == 0 || p->readers == 0) {
+			bool broken;
+
+			lock_acquire (&p->lock);
+			p->writer_waiting = true;
+			barrier ();
+			while ((space = PIPE_SIZE - (p->head - p->tail)) == 0
+					&& p->readers > 0)
+				cond_wait (&p->writable, &p->lock);
+			p->writer_waiting = false;
+			broken = p->readers == 0;
+			lock_release (&p->lock);
+			if (broken)
+				break;
+		}
+
+		n = size - written < space ? size - written : space;
+		ring_copy_in (p, p->head, buffer + written, n);
+		barrier ();
+		p->head += n;
+		barrier ();
+		written += n;
+
+		if (p->reader_waiting) {
+			lock_acquire (&p->lock);
+			cond_signal (&p->readable, &p->lock);
+			lock_release (&p->lock);
+		}
+	}
+	lock_release (&p->write_lock);
+	return written > 0 || size == 0 ? (int) written : -1;
+}
@@ -8,6 +8,8 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
+#include "userprog/pipe.h"
+#include "devices/disk.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -46,29 +48,37 @@ struct initd_fn{
 static bool
 process_init (void) {
 	struct thread *current = thread_current ();
-	current -> fd_table = malloc(sizeof (struct file_descriptor *) * MAX_FD);
-	if(current -> fd_table == NULL){
+	if(!fd_table_init(&current -> fd_table)){
 		return false;
 	}
-	for(int i = 0; i < MAX_FD; i++){
-		current -> fd_table[i] = NULL;
+
+	/* open/create/remove 등의 경로 인자를 매번 palloc 하지 않고 여기에 복사 */
+	current -> path_buf = malloc(PATH_BUF_SIZE);
+	if(current -> path_buf == NULL){
+		fd_table_destroy(&current -> fd_table);
+		return false;
 	}
 
 	struct file_descriptor *fd_0 = create_fd_wrapper((struct file *) NULL, FD_STDIN);
 	if(fd_0 == NULL) {
-		free(current -> fd_table);
+		fd_table_destroy(&current -> fd_table);
+		free(current -> path_buf);
+		current -> path_buf = NULL;
 		return false;
 	}
 
 	struct file_descriptor *fd_1 = create_fd_wrapper((struct file *) NULL, FD_STDOUT);
 	if(fd_1 == NULL) {
-		free(current -> fd_table);
+		fd_table_destroy(&current -> fd_table);
+		free(current -> path_buf);
+		current -> path_buf = NULL;
 		free(fd_0);
 		return false;
 	} 
 
-	current -> fd_table[0] = fd_0;
-	current -> fd_table[1] = fd_1;
+	/* 처음 크기 안이라 실패하지 않는다 */
+	fd_table_set(&current -> fd_table, 0, fd_0);
+	fd_table_set(&current -> fd_table, 1, fd_1);
 
 	return true;
 }
@@ -277,9 +287,7 @@ __do_fork (void *aux) {
 
 	process_activate (current);
 
-	lock_acquire(&filesys_lock);
 	struct file *dup_file = file_duplicate(parent->execute_file); //dent_cnt++ 위해
-	lock_release(&filesys_lock);
 	if(dup_file == NULL)
 		goto error;
 	current->execute_file = dup_file;
@@ -298,52 +306,54 @@ __do_fork (void *aux) {
 		goto error;
 
 	/* TODO: create_fd_wrapper 실패, file_duplicate 실패의 핸들링 고려하기 (누수 가능성)*/
-	for(int i = 0; i < MAX_FD; i++){
-		struct file_descriptor *parent_fd_info = parent -> fd_table[i];
+	/* process_init에서 생성된 기본 fd(0, 1)는 부모 것으로 대신함 */
+	for(int i = fd_table_next(&current -> fd_table, -1); i >= 0; i = fd_table_next(&current -> fd_table, i))
+		close_fd(fd_table_remove(&current -> fd_table, i));
 
-		/* process_init에서 생성된 기본 fd(0, 1)이나 이전 루프의 잔재를 정리 */
-		if (current -> fd_table[i] != NULL) {
-			close_fd(current -> fd_table[i]);
-			current -> fd_table[i] = NULL;
-		}
+	/* 부모의 열린 fd 만 순회한다. 먼저 지난 fork 의 흔적을 지움 */
+	struct fd_table *parent_fds = &parent -> fd_table;
+	for(int i = fd_table_next(parent_fds, -1); i >= 0; i = fd_table_next(parent_fds, i))
+		fd_table_get(parent_fds, i) -> fork_copy = NULL;
 
-		if(parent_fd_info == NULL) continue;
+	for(int i = fd_table_next(parent_fds, -1); i >= 0; i = fd_table_next(parent_fds, i)){
+		struct file_descriptor *parent_fd_info = fd_table_get(parent_fds, i);
+		struct file_descriptor *new_fd;
 
 		/* 부모 테이블에서 복사 관계가 확인되면 자식도 그 관계대로 복사*/
-		bool found = false;
-		if(parent_fd_info->ref_count >= 2){
-			for(int j = 0; j < i; j++){
-				if(parent_fd_info == parent -> fd_table[j]){
-					current -> fd_table[i] = current -> fd_table[j];					
-					current -> fd_table[i] -> ref_count++;
-					found = true;
-					break;
-				}
-			}
-		}
-		if(found) continue;
-
-		/* 복사 관계가 없으면 그냥 복사 */
-		struct file *child_file = NULL;
-		if(parent_fd_info -> type == FD_FILE){
-			lock_acquire(&filesys_lock);
-			child_file = file_duplicate(parent_fd_info -> file);
-			lock_release(&filesys_lock);
+		if(parent_fd_info -> fork_copy != NULL){
+			new_fd = parent_fd_info -> fork_copy;
+			new_fd -> ref_count++;
+		} else if(parent_fd_info -> type == FD_FILE){
+			/* 복사 관계가 없으면 그냥 복사 */
+			struct file *child_file = file_duplicate(parent_fd_info -> file);
 			if(child_file == NULL){
 				goto error;
 			}
-			struct file_descriptor *new_fd = create_fd_wrapper(child_file, parent_fd_info -> type);
+			new_fd = create_fd_wrapper(child_file, parent_fd_info -> type);
 			if (new_fd == NULL) {
-				lock_acquire(&filesys_lock);
 				file_close(child_file);
-				lock_release(&filesys_lock);
 				goto error;
 			}
-			current -> fd_table[i] = new_fd;
+		} else if(parent_fd_info -> type == FD_PIPE_READ || parent_fd_info -> type == FD_PIPE_WRITE){
+			/* 파이프는 같은 파이프의 끝을 하나 더 연다 */
+			new_fd = create_fd_wrapper(NULL, parent_fd_info -> type);
+			if (new_fd == NULL)
+				goto error;
+			new_fd -> pipe = parent_fd_info -> pipe;
+			pipe_open_end(new_fd -> pipe, new_fd -> type == FD_PIPE_WRITE);
 		} else {
-			/* FD_STDIN, FD_STDOUT*/
-			current -> fd_table[i] = parent_fd_info;
-			parent_fd_info -> ref_count++;
+			/* FD_STDIN, FD_STDOUT 은 wrapper 를 그대로 공유 (다른 프로세스와도 공유되므로 fork_copy 안 씀) */
+			new_fd = parent_fd_info;
+			new_fd -> ref_count++;
+		}
+
+		if(parent_fd_info -> type != FD_STDIN && parent_fd_info -> type != FD_STDOUT)
+			parent_fd_info -> fork_copy = new_fd;
+
+		/* 부모와 같은 크기까지만 자라므로 메모리가 없을 때만 실패 */
+		if(!fd_table_set(&current -> fd_table, i, new_fd)){
+			close_fd(new_fd);
+			goto error;
 		}
 	}
 
@@ -447,15 +457,13 @@ process_exit (void) {
 	}
 
 	// Process termination -> 파일 설명자 테이블 제거 
-	if(curr -> fd_table != NULL){
-		for(int i = 0; i < MAX_FD; i++){
-			if(curr -> fd_table[i] != NULL){
-				close_fd(curr -> fd_table[i]);
-			}
-		}
-		free(curr -> fd_table);
-		curr -> fd_table = NULL;
+	if(curr -> fd_table.fds != NULL){
+		for(int i = fd_table_next(&curr -> fd_table, -1); i >= 0; i = fd_table_next(&curr -> fd_table, i))
+			close_fd(fd_table_remove(&curr -> fd_table, i));
+		fd_table_destroy(&curr -> fd_table);
 	}
+	free(curr -> path_buf);
+	curr -> path_buf = NULL;
 	process_cleanup();
 
 	/* 부모가 자식보다 먼저 죽으면 직계 자식의 자식 관련 구조체 제거 -> 추후 고아 프로세스 로직으로 대체예정(사용 금지)*/
@@ -479,9 +487,7 @@ static void
 process_cleanup (void) {
 	struct thread *curr = thread_current ();
 	if(curr -> execute_file != NULL){
-		lock_acquire(&filesys_lock);
 		file_close(curr -> execute_file);
-		lock_release(&filesys_lock);
 		curr -> execute_file = NULL;
 	}
 
@@ -616,9 +622,7 @@ load (const char *file_name, struct intr_frame *if_) {
 	process_activate (thread_current ());
 
 	/* Open executable file. */
-	lock_acquire(&filesys_lock);
 	file = filesys_open (argv[0]);
-	lock_release(&filesys_lock);
 	if (file == NULL) {
 		printf ("load: %s: open failed\n", argv[0]);
 		goto done;
@@ -923,12 +927,12 @@ lazy_load_segment (struct page *page, void *aux) {
 	/* 할당받은 페이지에 파일 내용을 읽어 채운다. */
 	void *kpage = page->frame->kva;
 
-	lock_acquire(&filesys_lock);
-	if (file_read_at (file, kpage, page_read_bytes, ofs) != (int) page_read_bytes){
-		lock_release(&filesys_lock);
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_PAGE_CACHE);
+	off_t read_bytes = file_read_at (file, kpage, page_read_bytes, ofs);
+	disk_user_end (old_user);
+	if (read_bytes != (int) page_read_bytes){
 		return false; // 실패시 free 처리 추가?
 	}
-	lock_release(&filesys_lock);
 	
 	memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
@@ -12,8 +12,12 @@
 #include "filesys/filesys.h"
 #include "threads/palloc.h"
 #include "userprog/process.h"
+#include "userprog/pipe.h"
+#include "devices/disk.h"
 #include "devices/input.h"
 #include "threads/malloc.h"
+#include <iovec.h>
+#include <limits.h>
 #include <string.h>
 
 #include "vm/vm.h"
@@ -32,6 +36,7 @@ static int s_filesize(int fd);
 //static bool check_buffer(void *buffer, int length);
 static int64_t get_user(const uint8_t *uadder);
 static bool put_user(uint8_t *udst, uint8_t byte);
+static const char *get_user_path(const char *upath);
 static int s_wait(tid_t pid);
 static tid_t s_fork(const char *thread_name, struct intr_frame *f);
 static int s_exec(const char *cmd_line);
@@ -41,11 +46,29 @@ static unsigned s_tell(int fd);
 static int s_dup2(int oldfd, int newfd);
 static void *s_mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 static void s_munmap(void *addr);
+static bool s_diskstat(int chan_no, int dev_no, struct diskstat *ust);
+static int s_fsync(int fd);
+static int s_pread(int fd, void *buffer, unsigned size, off_t offset);
+static int s_pwrite(int fd, const void *buffer, unsigned size, off_t offset);
+static int s_readv(int fd, const struct iovec *iov, int iovcnt);
+static int s_writev(int fd, const struct iovec *iov, int iovcnt);
+static int fd_read(struct file_descriptor *wrap_fd, void *buffer, unsigned size, off_t offset);
+static int fd_write(struct file_descriptor *wrap_fd, const void *buffer, unsigned size, off_t offset);
+static int fd_iov(int fd, const struct iovec *uiov, int iovcnt, bool read);
+static int s_copy_file_range(int fd_in, off_t off_in, int fd_out, off_t off_out, unsigned len);
+static int s_pipe(int *fds);
+static void *s_shm_attach(int key, size_t size, void *addr);
+static bool s_shm_detach(void *addr);
+static int install_fd(struct file_descriptor *wrap_fd);
 
 static void valid_get_addr(void *addr);
 static void valid_get_buffer(char *addr, unsigned length);
 static void valid_put_addr(char *addr, unsigned length);
+static bool valid_buffer(const char *buffer, unsigned length, bool write);
 static bool valid_writable (void *uaddr);
+static void pin_buffer(const void *buffer, unsigned length);
+static void unpin_buffer(const void *buffer, unsigned length);
+static int pinned_transfer(struct file_descriptor *wrap_fd, void *buffer, unsigned size, off_t offset, bool write);
 
 /* System call.
  *
@@ -60,7 +83,8 @@ static bool valid_writable (void *uaddr);
 #define MSR_LSTAR 0xc0000082        /* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
 
-struct lock filesys_lock;
+/* read/write 가 한 번에 frame 에 고정하는 최대 유저 페이지 수 */
+#define PIN_WINDOW_PAGES 32
 
 
 static int64_t
@@ -93,6 +117,108 @@ put_user (uint8_t *udst, uint8_t byte) {
     return error_code != -1;
 }
 
+/* 유저 범위 [UADDR, UADDR + SIZE) 가 전부 유저 영역 안에 있는지 */
+static bool
+is_user_range (const void *uaddr, size_t size) {
+	uintptr_t start = (uintptr_t) uaddr;
+	if (uaddr == NULL || start + size < start)
+		return false;
+	return size == 0 || is_user_vaddr ((void *) (start + size - 1));
+}
+
+/* 유저 USRC 에서 SIZE 바이트를 DST 로 한 번에 복사한다.
+ * get_user 와 같은 방식: rax 에 착지 주소를 넣어 두면 커널 모드
+ * 페이지 폴트가 rip = rax, rax = -1 로 돌려보낸다. rep movsb 하나로
+ * 복사하므로 폴트 착지점도 하나이고, lazy 페이지는 폴트 처리 후
+ * 같은 명령이 이어서 실행된다. 실패하면 false. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size) {
+	int64_t result;
+
+	if (!is_user_range (usrc, size))
+		return false;
+
+	__asm __volatile (
+		"movabsq $1f, %0\n"
+		"rep movsb\n"
+		"1:\n"
+		: "=&a" (result), "+D" (dst), "+S" (usrc), "+c" (size)
+		: : "memory");
+	return result != -1;
+}
+
+/* 커널 SRC 에서 유저 UDST 로 SIZE 바이트 복사. 읽기 전용 페이지에
+ * 쓰려 하면 폴트 착지점으로 빠져 false 를 돌려준다. */
+bool
+copy_to_user (void *udst, const void *src, size_t size) {
+	int64_t result;
+
+	if (!is_user_range (udst, size))
+		return false;
+
+	__asm __volatile (
+		"movabsq $1f, %0\n"
+		"rep movsb\n"
+		"1:\n"
+		: "=&a" (result), "+D" (udst), "+S" (src), "+c" (size)
+		: : "memory");
+	return result != -1;
+}
+
+/* 유저 문자열 USRC 를 최대 SIZE 바이트(NUL 포함)까지 DST 로 복사한다.
+ * 문자열 길이(NUL 제외)를 돌려주고, SIZE 안에 NUL 이 없으면 SIZE,
+ * 잘못된 주소면 -1. 바이트마다 get_user 를 부르지 않고 루프 전체를
+ * 하나의 착지점으로 보호한다. */
+int64_t
+strncpy_from_user (char *dst, const char *usrc, size_t size) {
+	int64_t result;
+	size_t left = size;
+
+	if (usrc == NULL || is_kernel_vaddr (usrc))
+		return -1;
+	if (size == 0)
+		return 0;
+
+	__asm __volatile (
+		"movabsq $2f, %0\n"
+		"1:\n"
+		"movb (%2), %%dl\n"
+		"movb %%dl, (%1)\n"
+		"incq %2\n"
+		"incq %1\n"
+		"decq %3\n"
+		"testb %%dl, %%dl\n"
+		"jz 2f\n"
+		"testq %3, %3\n"
+		"jnz 1b\n"
+		"2:\n"
+		: "=&a" (result), "+r" (dst), "+r" (usrc), "+r" (left)
+		: : "rdx", "cc", "memory");
+
+	if (result == -1)
+		return -1;
+	/* 커널 주소 직전까지 올라간 문자열은 여기서 잘라낸다. */
+	if (is_kernel_vaddr (usrc - 1))
+		return -1;
+	if (dst[-1] != '\0')
+		return size;
+	return size - left - 1;
+}
+
+/* 유저 경로 문자열을 현재 스레드의 path_buf 로 복사해 돌려준다.
+ * 잘못된 포인터면 프로세스 종료, PATH_BUF_SIZE 에 안 들어가면 NULL. */
+static const char *
+get_user_path (const char *upath) {
+	char *buf = thread_current ()->path_buf;
+	int64_t len = strncpy_from_user (buf, upath, PATH_BUF_SIZE);
+
+	if (len < 0)
+		s_exit (-1);
+	if (len == PATH_BUF_SIZE)
+		return NULL;
+	return buf;
+}
+
 
 void
 syscall_init (void) {
@@ -105,7 +231,6 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
-	lock_init(&filesys_lock);
 }
 
 /* The main system call interface */
@@ -187,6 +312,46 @@ syscall_handler (struct intr_frame *f) {
 			s_munmap((void *)f -> R.rdi);
 			break;
 
+		case SYS_DISKSTAT:
+			f->R.rax = s_diskstat((int) f->R.rdi, (int) f->R.rsi, (struct diskstat *) f->R.rdx);
+			break;
+
+		case SYS_FSYNC:
+			f->R.rax = s_fsync((int) f->R.rdi);
+			break;
+
+		case SYS_PREAD:
+			f->R.rax = s_pread((int) f->R.rdi, (void *) f->R.rsi, (unsigned) f->R.rdx, (off_t) f->R.r10);
+			break;
+
+		case SYS_PWRITE:
+			f->R.rax = s_pwrite((int) f->R.rdi, (const void *) f->R.rsi, (unsigned) f->R.rdx, (off_t) f->R.r10);
+			break;
+
+		case SYS_READV:
+			f->R.rax = s_readv((int) f->R.rdi, (const struct iovec *) f->R.rsi, (int) f->R.rdx);
+			break;
+
+		case SYS_WRITEV:
+			f->R.rax = s_writev((int) f->R.rdi, (const struct iovec *) f->R.rsi, (int) f->R.rdx);
+			break;
+
+		case SYS_COPY_FILE_RANGE:
+			f->R.rax = s_copy_file_range((int) f->R.rdi, (off_t) f->R.rsi, (int) f->R.rdx, (off_t) f->R.r10, (unsigned) f->R.r8);
+			break;
+
+		case SYS_PIPE:
+			f->R.rax = s_pipe((int *) f->R.rdi);
+			break;
+
+		case SYS_SHM_ATTACH:
+			f->R.rax = (uint64_t) s_shm_attach((int) f->R.rdi, (size_t) f->R.rsi, (void *) f->R.rdx);
+			break;
+
+		case SYS_SHM_DETACH:
+			f->R.rax = s_shm_detach((void *) f->R.rdi);
+			break;
+
 		default:
 			printf("undefined system call! %llu\n", syscall_num); 
 			s_exit(-1);
@@ -201,34 +366,104 @@ valid_get_addr(void *addr){
 	if(get_user(addr) < 0)
 		s_exit(-1);
 }
-/* 버퍼에서 가져오기 검사 */
-static void 
-valid_get_buffer(char *buffer, unsigned length){
-
-	// 버퍼 범위의 모든 페이지를 체크
+/* 버퍼 범위의 모든 페이지를 읽을 수 (write 면 쓸 수) 있는지 검사 */
+static bool
+valid_buffer(const char *buffer, unsigned length, bool write){
 	void *start_page = pg_round_down(buffer);
 	void *end_page = pg_round_down(buffer + length -1);
 
 	for (void *page = start_page; page <= end_page; page += PGSIZE) {
 		// 각 페이지의 첫 바이트에 get_user로 접근 가능 여부 체크
-		if(get_user(page) < 0)
-			s_exit(-1);
+		if((write && !valid_writable(page)) || get_user(page) < 0)
+			return false;
 	}
+	return true;
+}
+
+/* 버퍼에서 가져오기 검사 */
+static void 
+valid_get_buffer(char *buffer, unsigned length){
+	if(!valid_buffer(buffer, length, false))
+		s_exit(-1);
 }
 
 /* 버퍼에 쓰기 검사 */
 static void 
 valid_put_buffer(char *buffer, unsigned length){
+	if(!valid_buffer(buffer, length, true))
+		s_exit(-1);
+}
+
+/* 검증이 끝난 버퍼가 걸친 페이지를 전부 frame 에 올리고 고정한다.
+ * inode 락을 잡은 채로 유저 버퍼에서 폴트가 나면 lazy load 가
+ * 같은 inode 의 락을 다시 필요로 할 수 있으므로, 읽기/쓰기 전에 부른다. */
+static void
+pin_buffer(const void *buffer, unsigned length){
+	if(length == 0)
+		return;
 
-	// 버퍼 범위의 모든 페이지를 체크
 	void *start_page = pg_round_down(buffer);
-	void *end_page = pg_round_down(buffer + length -1);
+	void *end_page = pg_round_down(buffer + length - 1);
 
 	for (void *page = start_page; page <= end_page; page += PGSIZE) {
-		// 각 페이지의 첫 바이트에 get_user로 접근 가능 여부 체크
-		if(!valid_writable(page) || get_user(page) < 0)
+		if(!vm_pin_page(page)){
+			unpin_buffer(start_page, page - start_page);
 			s_exit(-1);
+		}
+	}
+}
+
+/* pin_buffer 로 고정한 페이지들을 다시 eviction 대상으로 돌린다. */
+static void
+unpin_buffer(const void *buffer, unsigned length){
+	if(length == 0)
+		return;
+
+	void *start_page = pg_round_down(buffer);
+	void *end_page = pg_round_down(buffer + length - 1);
+
+	for (void *page = start_page; page <= end_page; page += PGSIZE)
+		vm_unpin_page(page);
+}
+
+/* buffer 의 size 바이트를 wrap_fd 와 주고받되, 한 번에 PIN_WINDOW_PAGES
+ * 페이지까지만 고정한다. 큰 버퍼를 통째로 고정하면 유저 풀의 frame 이 모두
+ * 고정돼 clock 이 victim 을 찾지 못한다. offset 이 음수면 파일 위치를 쓴다.
+ * 짧게 옮겨지면 (EOF, 파이프) 거기서 멈추고, 옮긴 바이트 수나 하나도 못
+ * 옮겼을 때의 -1 을 돌려준다. */
+static int
+pinned_transfer(struct file_descriptor *wrap_fd, void *buffer, unsigned size, off_t offset, bool write){
+	unsigned done = 0;
+
+	while(done < size){
+		uint8_t *window = (uint8_t *) buffer + done;
+		unsigned len = PIN_WINDOW_PAGES * PGSIZE - pg_ofs(window);
+		int n = -1;
+
+		if(len > size - done)
+			len = size - done;
+
+		pin_buffer(window, len);
+		if(wrap_fd -> type == FD_FILE && write)
+			n = offset >= 0 ? file_write_at(wrap_fd -> file, window, len, offset + done)
+				: file_write(wrap_fd -> file, window, len);
+		else if(wrap_fd -> type == FD_FILE)
+			n = offset >= 0 ? file_read_at(wrap_fd -> file, window, len, offset + done)
+				: file_read(wrap_fd -> file, window, len);
+		else if(wrap_fd -> type == FD_PIPE_WRITE)
+			n = pipe_write(wrap_fd -> pipe, window, len);
+		else if(wrap_fd -> type == FD_PIPE_READ)
+			n = pipe_read(wrap_fd -> pipe, window, len);
+		unpin_buffer(window, len);
+
+		if(n < 0)
+			return done > 0 ? (int) done : -1;
+		done += n;
+		/* 파이프 읽기는 있는 만큼만 돌려주므로 다음 창에서 기다리지 않는다 */
+		if((unsigned) n < len || wrap_fd -> type == FD_PIPE_READ)
+			break;
 	}
+	return (int) done;
 }
 
 static bool
@@ -256,12 +491,23 @@ static int
 s_write (int fd, const void *buffer, unsigned length){
 	valid_get_buffer(buffer, length);
 	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
-	struct file *cur_file = NULL;
-	int actual_byte_written = 0;
 
 	if(wrap_fd == NULL) return -1;
+	return fd_write(wrap_fd, buffer, length, -1);
+}
+
+/* 검증이 끝난 buffer 의 length 바이트를 wrap_fd 에 쓴다.
+ * offset 이 음수면 파일 위치에 쓰고 위치를 옮기며, 아니면 그 위치에 쓰고
+ * 파일 위치는 그대로 둔다 (파일만 가능). 실패하면 -1. */
+static int
+fd_write(struct file_descriptor *wrap_fd, const void *buffer, unsigned length, off_t offset){
+	struct file *cur_file = NULL;
+	int actual_byte_written = 0;
 	enum fd_type f_type = wrap_fd -> type;
 
+	if(offset >= 0 && f_type != FD_FILE)
+		return -1;
+
 	switch (f_type){
 		case FD_STDIN:
 			actual_byte_written = -1;
@@ -278,24 +524,29 @@ s_write (int fd, const void *buffer, unsigned length){
 				actual_byte_written = -1;
 				break;
 			}
-			lock_acquire(&filesys_lock);
-			actual_byte_written = (int) file_write(cur_file, buffer, length);
-			lock_release(&filesys_lock);
+			actual_byte_written = pinned_transfer(wrap_fd, (void *) buffer, length, offset, true);
+			break;
+
+		case FD_PIPE_READ:
+			actual_byte_written = -1;
+			break;
+
+		case FD_PIPE_WRITE:
+			/* pipe_write 가 유저 버퍼를 memcpy 로 직접 읽으므로 frame 에 고정 */
+			actual_byte_written = pinned_transfer(wrap_fd, (void *) buffer, length, -1, true);
 			break;
 	}
 	return actual_byte_written;
-};
+}
 
 static bool 
 s_create(const char *file, unsigned initial_size){
-	valid_get_addr(file);
-	if(strlen(file) > 14){
+	file = get_user_path(file);
+	if(file == NULL || strlen(file) > 14){
 		return false;
 	}
 
-	lock_acquire(&filesys_lock);
 	bool result = filesys_create(file, initial_size);
-	lock_release(&filesys_lock);
 	if(!result){
 		return false;
 	}
@@ -305,22 +556,13 @@ s_create(const char *file, unsigned initial_size){
 /* 파일 식별자로 변환하고 식별자 번호를 리턴한다. */
 static int
 s_open(const char *file){
-	valid_get_addr(file);
-	struct thread *cur = thread_current();
-
-	char *fn_copy = palloc_get_page(0);
-	if(fn_copy == NULL){
+	file = get_user_path(file);
+	if(file == NULL){
 		return -1;
 	}
-	strlcpy(fn_copy, file, PGSIZE);
-
-	
-	lock_acquire(&filesys_lock);
-	struct file *new_file = filesys_open(fn_copy);
-	lock_release(&filesys_lock);
 
+	struct file *new_file = filesys_open(file);
 
-	palloc_free_page(fn_copy);
 	if(new_file == NULL){
 		return -1;
 	}
@@ -331,35 +573,28 @@ s_open(const char *file){
 		return -1;
 	}
 
-	int fd = -1;
-
-	for (int i = 2; i < MAX_FD; i++)
-	{
-		if(cur -> fd_table[i] == NULL){
-			cur -> fd_table[i] = wrap_fd;
-			fd = i;
-			break;
-		}
-	}
+	int fd = install_fd(wrap_fd);
 
 	if(fd < 0) {
-		lock_acquire(&filesys_lock);
 		file_close(new_file);
-		lock_release(&filesys_lock);
 		free(wrap_fd);
 	}
 
 	return fd;
 }
 
+/* wrap_fd 를 비어 있는 가장 작은 fd (2 이상) 에 넣고 그 번호를 돌려준다.
+ * 자리가 없으면 -1. */
+static int
+install_fd(struct file_descriptor *wrap_fd){
+	return fd_table_install(&thread_current() -> fd_table, 2, wrap_fd);
+}
+
 static void 
 s_close(int fd){
-	struct thread *cur = thread_current();
-	struct file_descriptor *target = get_fd_wrapper(fd);
-	if(target != NULL){
+	struct file_descriptor *target = fd_table_remove(&thread_current() -> fd_table, fd);
+	if(target != NULL)
 		close_fd(target);
-		cur -> fd_table[fd] = NULL;
-	}
 }
 
 static int
@@ -377,9 +612,10 @@ s_filesize(int fd){
 			break;
 
 		case FD_FILE:
-			lock_acquire(&filesys_lock);
 			file_len = (int) file_length(cur_file);
-			lock_release(&filesys_lock);
+			break;
+
+		default:
 			break;
 	}
 	return file_len;
@@ -394,21 +630,36 @@ s_read(int fd, void *buffer, unsigned size){
 	valid_put_buffer(buffer, size);
 
 	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
-	int bytes_rd = -1;
 
 	if(wrap_fd == NULL){
 		return -1;
 	}
+	return fd_read(wrap_fd, buffer, size, -1);
+}
+
+/* 검증이 끝난 buffer 로 wrap_fd 에서 size 바이트를 읽는다.
+ * offset 이 음수면 파일 위치에서 읽고 위치를 옮기며, 아니면 그 위치에서 읽고
+ * 파일 위치는 그대로 둔다 (파일만 가능). 실패하면 -1. */
+static int
+fd_read(struct file_descriptor *wrap_fd, void *buffer, unsigned size, off_t offset){
+	int bytes_rd = -1;
+
+	if(offset >= 0 && wrap_fd -> type != FD_FILE)
+		return -1;
 
 	switch (wrap_fd ->type){
 		case FD_STDIN:
 			unsigned rd_size = 0;
-			uint8_t *buf = (uint8_t *) buffer;
+			uint8_t chunk[64];
 
+			/* 키 입력을 모아서 덩어리 단위로 유저 버퍼에 복사 */
 			while(rd_size < size){
-				uint8_t ch = input_getc();
-				buf[rd_size] = ch;
-				rd_size++;
+				unsigned n = 0;
+				while(n < sizeof chunk && rd_size + n < size)
+					chunk[n++] = input_getc();
+				if(!copy_to_user((uint8_t *) buffer + rd_size, chunk, n))
+					s_exit(-1);
+				rd_size += n;
 			}
 			bytes_rd = (int) rd_size;
 			break;
@@ -421,10 +672,11 @@ s_read(int fd, void *buffer, unsigned size){
 			if(cur_file == NULL){
 				return -1;
 			}
-			lock_acquire(&filesys_lock);
-			off_t bytes_read = file_read(cur_file, buffer, size);
-			lock_release(&filesys_lock);
-			bytes_rd = (int) bytes_read;
+			bytes_rd = pinned_transfer(wrap_fd, buffer, size, offset, false);
+			break;
+
+		case FD_PIPE_READ:
+			bytes_rd = pinned_transfer(wrap_fd, buffer, size, -1, false);
 			break;
 
 		default:
@@ -435,12 +687,21 @@ s_read(int fd, void *buffer, unsigned size){
 
 static int 
 s_exec(const char *cmd_line){
-	valid_get_addr(cmd_line);
-	char *cm_copy = palloc_get_page(PAL_ZERO);
+	char *cm_copy = palloc_get_page(0);
 	if(cm_copy == NULL) return -1;
-	strlcpy(cm_copy, cmd_line, PGSIZE);
+
+	/* process_exec 가 페이지째 free 하므로 여기는 페이지로 받는다 */
+	int64_t len = strncpy_from_user(cm_copy, cmd_line, PGSIZE);
+	if(len < 0){
+		palloc_free_page(cm_copy);
+		s_exit(-1);
+	}
+	if(len == PGSIZE){
+		palloc_free_page(cm_copy);
+		return -1;
+	}
 	return process_exec(cm_copy);
-	
+
 }
 
 static int 
@@ -450,26 +711,24 @@ s_wait(tid_t pid){
 
 static tid_t 
 s_fork(const char *thread_name, struct intr_frame *f){
-	valid_get_addr(thread_name);
+	thread_name = get_user_path(thread_name);
+	if(thread_name == NULL) return TID_ERROR;
 	return process_fork(thread_name, f);
 }
 
 static void 
 s_seek(int fd, unsigned position){
 	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
-	if(wrap_fd == NULL || wrap_fd -> type == FD_STDIN || wrap_fd -> type == FD_STDOUT) return;
-	lock_acquire(&filesys_lock);
+	if(wrap_fd == NULL || wrap_fd -> type != FD_FILE) return;
 	file_seek(wrap_fd -> file, position);
-	lock_release(&filesys_lock);
 }
 
 static bool 
 s_remove(const char *file){
 	bool result = false;
-	valid_get_addr(file);
-	lock_acquire(&filesys_lock);
+	file = get_user_path(file);
+	if(file == NULL) return false;
 	result = filesys_remove(file);
-	lock_release(&filesys_lock);
 	return result;
 }
 
@@ -477,26 +736,25 @@ static unsigned
 s_tell(int fd){
 	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
 	unsigned pos = 0;
-	if(wrap_fd == NULL) return pos;
-	lock_acquire(&filesys_lock);
+	if(wrap_fd == NULL || wrap_fd -> type != FD_FILE) return pos;
 	pos = file_tell(wrap_fd -> file);
-	lock_release(&filesys_lock);
 	return pos;
 }
 
 static int 
 s_dup2(int oldfd, int newfd){
-	if(oldfd < 0 || newfd < 0 || oldfd >= MAX_FD || newfd >= MAX_FD) return -1;
+	if(oldfd < 0 || newfd < 0 || newfd >= MAX_FD) return -1;
 	struct file_descriptor *wrap_oldfd = get_fd_wrapper(oldfd);
 	struct file_descriptor *wrap_newfd = get_fd_wrapper(newfd);
 	struct thread *cur = thread_current();
 	
 	if(wrap_oldfd == NULL) return -1;
 	if(wrap_newfd == wrap_oldfd) return newfd;
-	if(wrap_newfd != NULL) close_fd(wrap_newfd);
 
-	cur -> fd_table[newfd] = wrap_oldfd;
+	/* newfd 가 테이블 밖이면 자리를 먼저 늘려 둔다, 실패하면 닫지 않고 -1 */
+	if(!fd_table_set(&cur -> fd_table, newfd, wrap_oldfd)) return -1;
 	wrap_oldfd -> ref_count++;
+	if(wrap_newfd != NULL) close_fd(wrap_newfd);
 	return newfd;
 }
 
@@ -535,6 +793,286 @@ s_munmap(void *addr){
 	do_munmap(addr);
 }
 
+/* 검증만 하고 do_shm_attach 호출하자, 실패시 NULL */
+static void *
+s_shm_attach(int key, size_t size, void *addr){
+
+	void *end = addr + size;
+
+	if(addr == NULL || pg_round_down(addr) != addr || is_stack_vaddr(addr) || is_kernel_vaddr(addr))
+		return NULL;
+	if(size == 0 || end < addr || is_stack_vaddr(end) || is_kernel_vaddr(end))
+		return NULL;
+
+	/* 페이지 범위가 기존 매핑된 페이지와 겹칠 경우 검증 */
+	for(void *upage = addr; upage < end; upage += PGSIZE){
+		if(spt_find_page(&thread_current()->spt, upage))
+			return NULL;
+	}
+
+	return do_shm_attach(key, size, addr);
+}
+
+static bool
+s_shm_detach(void *addr){
+	if(addr == NULL || is_kernel_vaddr(addr))
+		return false;
+	return do_shm_detach(addr);
+}
+
+/* chan_no:dev_no 디스크의 통계와 현재 스레드의 섹터 수를 ust 에 복사한다.
+ * 그런 디스크가 없으면 false. */
+static bool
+s_diskstat(int chan_no, int dev_no, struct diskstat *ust){
+	struct thread *cur = thread_current();
+	struct diskstat st;
+	struct disk *d;
+
+	if(chan_no < 0 || (dev_no != 0 && dev_no != 1))
+		return false;
+	d = disk_get(chan_no, dev_no);
+	if(d == NULL)
+		return false;
+
+	disk_get_stats(d, &st);
+	st.thread_sectors[DISKSTAT_READ] = cur->disk_sectors[DISKSTAT_READ];
+	st.thread_sectors[DISKSTAT_WRITE] = cur->disk_sectors[DISKSTAT_WRITE];
+	if(!copy_to_user(ust, &st, sizeof st))
+		s_exit(-1);
+	return true;
+}
+
+/* fd 가 가리키는 파일의 캐시에만 있는 데이터를 디스크에 쓰고 나서 돌아온다.
+ * 성공하면 0, 파일이 아닌 fd 면 -1. */
+static int
+s_fsync(int fd){
+	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
+
+	if(wrap_fd == NULL || wrap_fd->type != FD_FILE || wrap_fd->file == NULL)
+		return -1;
+	file_sync(wrap_fd->file);
+	return 0;
+}
+
+/* 파일 위치를 쓰지도 옮기지도 않고 offset 에서 size 바이트를 읽는다.
+ * 같은 파일을 공유하는 프로세스끼리 seek 와 read 를 묶어 줄 필요가 없다. */
+static int
+s_pread(int fd, void *buffer, unsigned size, off_t offset){
+	if(offset < 0)
+		return -1;
+	/* offset + size 가 off_t 를 넘어가지 않도록 자른다 */
+	if(size > (unsigned) (OFF_MAX - offset))
+		size = OFF_MAX - offset;
+	if(size == 0)
+		return 0;
+
+	valid_put_buffer(buffer, size);
+
+	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
+	if(wrap_fd == NULL)
+		return -1;
+	return fd_read(wrap_fd, buffer, size, offset);
+}
+
+/* 파일 위치를 쓰지도 옮기지도 않고 offset 에 size 바이트를 쓴다. */
+static int
+s_pwrite(int fd, const void *buffer, unsigned size, off_t offset){
+	if(offset < 0)
+		return -1;
+	/* offset + size 가 off_t 를 넘어가지 않도록 자른다 */
+	if(size > (unsigned) (OFF_MAX - offset))
+		size = OFF_MAX - offset;
+	if(size == 0)
+		return 0;
+
+	valid_get_buffer((char *) buffer, size);
+
+	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
+	if(wrap_fd == NULL)
+		return -1;
+	return fd_write(wrap_fd, buffer, size, offset);
+}
+
+static int
+s_readv(int fd, const struct iovec *iov, int iovcnt){
+	return fd_iov(fd, iov, iovcnt, true);
+}
+
+static int
+s_writev(int fd, const struct iovec *iov, int iovcnt){
+	return fd_iov(fd, iov, iovcnt, false);
+}
+
+/* readv/writev 공통. 유저 iovec 배열을 한 번에 복사하고 모든 버퍼를 먼저
+ * 검증한 뒤, 버퍼 순서대로 파일 위치에서 읽거나 (read) 쓴다.
+ * 짧게 읽거나 쓰면 거기서 멈추고 그때까지의 바이트 수를 돌려준다.
+ * iovcnt 가 IOV_MAX 를 넘거나 합계가 int 를 넘으면 -1. */
+static int
+fd_iov(int fd, const struct iovec *uiov, int iovcnt, bool read){
+	struct file_descriptor *wrap_fd = get_fd_wrapper(fd);
+	struct iovec *iov;
+	size_t total_len = 0;
+	int total = 0;
+
+	if(wrap_fd == NULL || iovcnt < 0 || iovcnt > IOV_MAX)
+		return -1;
+	if(iovcnt == 0)
+		return 0;
+
+	iov = malloc(iovcnt * sizeof *iov);
+	if(iov == NULL)
+		return -1;
+	if(!copy_from_user(iov, uiov, iovcnt * sizeof *iov)){
+		free(iov);
+		s_exit(-1);
+	}
+	for(int i = 0; i < iovcnt; i++){
+		total_len += iov[i].iov_len;
+		if(iov[i].iov_len > INT_MAX || total_len > INT_MAX){
+			free(iov);
+			return -1;
+		}
+		if(iov[i].iov_len > 0 && !valid_buffer(iov[i].iov_base, iov[i].iov_len, read)){
+			free(iov);
+			s_exit(-1);
+		}
+	}
+
+	for(int i = 0; i < iovcnt; i++){
+		if(iov[i].iov_len == 0)
+			continue;
+		int n = read ? fd_read(wrap_fd, iov[i].iov_base, iov[i].iov_len, -1)
+			: fd_write(wrap_fd, iov[i].iov_base, iov[i].iov_len, -1);
+		if(n < 0){
+			if(total == 0)
+				total = -1;
+			break;
+		}
+		total += n;
+		if((size_t) n < iov[i].iov_len)
+			break;
+	}
+	free(iov);
+	return total;
+}
+
+/* fd_in 의 off_in 부터 len 바이트를 fd_out 의 off_out 으로 커널 안에서 복사한다.
+ * 데이터는 유저 버퍼를 거치지 않고 커널 페이지 하나로 옮겨지며, 읽기는
+ * 버퍼 캐시와 readahead 를 그대로 탄다. off 가 -1 이면 그 fd 의 파일 위치를
+ * 쓰고 복사한 만큼 옮긴다. fd_out 이 stdout 이나 파이프면 그리로 내보낸다
+ * (sendfile).
+ * 복사한 바이트 수를 돌려주고, 파일 끝에서는 0, 잘못된 인자면 -1.
+ * 같은 파일 안에서 겹치는 범위는 -1. */
+static int
+s_copy_file_range(int fd_in, off_t off_in, int fd_out, off_t off_out, unsigned len){
+	struct file_descriptor *in = get_fd_wrapper(fd_in);
+	struct file_descriptor *out = get_fd_wrapper(fd_out);
+	off_t in_pos, out_pos = 0;
+	uint8_t *buf;
+	int total = 0;
+
+	if(in == NULL || out == NULL || in->type != FD_FILE || in->file == NULL)
+		return -1;
+	if(off_in < -1 || off_out < -1)
+		return -1;
+	if(out->type == FD_STDOUT || out->type == FD_PIPE_WRITE){
+		if(off_out != -1)
+			return -1;
+	} else if(out->type != FD_FILE || out->file == NULL || is_file_allow_write(out->file))
+		return -1;
+	if(len > INT_MAX)
+		len = INT_MAX;
+
+	in_pos = off_in == -1 ? file_tell(in->file) : off_in;
+	if(out->type == FD_FILE)
+		out_pos = off_out == -1 ? file_tell(out->file) : off_out;
+
+	/* 위치가 off_t 를 넘어가지 않도록 자르고, 겹침 검사는 64비트로 */
+	if(len > (unsigned) (INT_MAX - (in_pos > out_pos ? in_pos : out_pos)))
+		len = INT_MAX - (in_pos > out_pos ? in_pos : out_pos);
+	if(out->type == FD_FILE && file_get_inode(in->file) == file_get_inode(out->file)
+			&& (int64_t) in_pos < (int64_t) out_pos + len
+			&& (int64_t) out_pos < (int64_t) in_pos + len)
+		return -1;
+
+	buf = palloc_get_page(0);
+	if(buf == NULL)
+		return -1;
+	while(len > 0){
+		off_t chunk = len < PGSIZE ? len : PGSIZE;
+		off_t rd = file_read_at(in->file, buf, chunk, in_pos);
+		off_t wr;
+		if(rd <= 0)
+			break;
+		if(out->type == FD_STDOUT){
+			putbuf((char *) buf, rd);
+			wr = rd;
+		} else if(out->type == FD_PIPE_WRITE)
+			wr = pipe_write(out->pipe, buf, rd);
+		else
+			wr = file_write_at(out->file, buf, rd, out_pos);
+		if(wr > 0){
+			in_pos += wr;
+			out_pos += wr;
+			total += wr;
+			len -= wr;
+		}
+		if(wr < rd)
+			break;
+	}
+	palloc_free_page(buf);
+
+	if(off_in == -1)
+		file_seek(in->file, in_pos);
+	if(off_out == -1 && out->type == FD_FILE)
+		file_seek(out->file, out_pos);
+	return total;
+}
+
+/* 파이프를 만들어 읽기 끝 fd 를 fds[0], 쓰기 끝 fd 를 fds[1] 에 넣는다.
+ * 성공하면 0, 파이프나 fd 를 만들 수 없으면 -1. */
+static int
+s_pipe(int *fds){
+	struct thread *cur = thread_current();
+	struct file_descriptor *rd_fd, *wr_fd;
+	struct pipe *p;
+	int kfds[2];
+
+	valid_put_buffer((char *) fds, sizeof kfds);
+
+	p = pipe_create();
+	if(p == NULL)
+		return -1;
+	rd_fd = create_fd_wrapper(NULL, FD_PIPE_READ);
+	wr_fd = create_fd_wrapper(NULL, FD_PIPE_WRITE);
+	if(rd_fd == NULL || wr_fd == NULL){
+		free(rd_fd);
+		free(wr_fd);
+		pipe_close_end(p, false);
+		pipe_close_end(p, true);
+		return -1;
+	}
+	rd_fd -> pipe = p;
+	wr_fd -> pipe = p;
+
+	kfds[0] = install_fd(rd_fd);
+	kfds[1] = kfds[0] < 0 ? -1 : install_fd(wr_fd);
+	if(kfds[1] < 0){
+		if(kfds[0] >= 0)
+			fd_table_remove(&cur -> fd_table, kfds[0]);
+		close_fd(rd_fd);
+		close_fd(wr_fd);
+		return -1;
+	}
+
+	if(!copy_to_user(fds, kfds, sizeof kfds)){
+		s_close(kfds[0]);
+		s_close(kfds[1]);
+		s_exit(-1);
+	}
+	return 0;
+}
+
 
 /* file을 받으면 wrapper 구조체인 file_descriptor를 반환하는 함수 */
 struct file_descriptor *create_fd_wrapper(struct file *f, enum fd_type f_type){
@@ -542,8 +1080,10 @@ struct file_descriptor *create_fd_wrapper(struct file *f, enum fd_type f_type){
 	struct file_descriptor *wrap_fd = (struct file_descriptor *)malloc(sizeof(struct file_descriptor));
 	if(wrap_fd == NULL) return NULL;
 	wrap_fd -> file = f;
+	wrap_fd -> pipe = NULL;
 	wrap_fd -> ref_count = 1;
 	wrap_fd -> type = f_type;
+	wrap_fd -> fork_copy = NULL;
 	return wrap_fd;
 }
 
@@ -553,17 +1093,14 @@ void close_fd(struct file_descriptor *fd_wrapper){
 
 	if(fd_wrapper -> ref_count == 0){
 		if(fd_wrapper -> type == FD_FILE){
-			lock_acquire(&filesys_lock);
 			file_close(fd_wrapper -> file);
-			lock_release(&filesys_lock);
+		} else if(fd_wrapper -> type == FD_PIPE_READ || fd_wrapper -> type == FD_PIPE_WRITE){
+			pipe_close_end(fd_wrapper -> pipe, fd_wrapper -> type == FD_PIPE_WRITE);
 		}
 		free(fd_wrapper);
 	}
 }
 
 struct file_descriptor *get_fd_wrapper(int fd){
-	if(fd < 0 || fd >= MAX_FD) return NULL;
-	struct thread *cur = thread_current();
-	struct file_descriptor *wrap_fd = cur -> fd_table[fd]; 
-	return wrap_fd;
+	return fd_table_get(&thread_current() -> fd_table, fd);
 }
\ No newline at end of file
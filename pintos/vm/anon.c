@@ -56,13 +56,8 @@ anon_swap_in (struct page *page, void *kva) {
 	size_t idx = anon_page->swap_slot_idx;
 	if(idx == BITMAP_ERROR) return false;
 	
-	//idx로부터 kva로 disk_read
-	size_t start_sector = idx * SECTOR_UNIT;
-	for (int i = 0; i < SECTOR_UNIT; i++) {
-		disk_read(swap_disk, start_sector + i, kva + (i * DISK_SECTOR_SIZE));
-	}
-	//bitmap 0으로 만들고 anon_page idx update
-	bitmap_set(swap_bm, idx, false);
+	//idx로부터 kva로 읽고 anon_page idx update
+	anon_swap_read(idx, kva);
 	anon_page->swap_slot_idx = BITMAP_ERROR;
 
 	return true;
@@ -74,16 +69,8 @@ static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
 
-	//swap_disk에서 빈 공간 찾기
-	size_t idx = bitmap_scan_and_flip(swap_bm, 0, 1, 0);
+	size_t idx = anon_swap_write(page->frame->kva);
 	if(idx == BITMAP_ERROR) return false;
-
-	// 해당 공간에 disk_write, idx 기록
-	void *kva = page->frame->kva;
-	size_t start_sector = idx * SECTOR_UNIT;
-    for (int i = 0; i < SECTOR_UNIT; i++) {
-		disk_write(swap_disk, start_sector + i, kva + (i * DISK_SECTOR_SIZE));
-    }
 	anon_page->swap_slot_idx = idx;
 
 	//pml4 매핑 해제(va)
@@ -92,6 +79,44 @@ anon_swap_out (struct page *page) {
 	return true;
 }
 
+/* swap slot 하나를 잡아 KVA 페이지를 기록하고 slot 번호를 돌려준다.
+   빈 slot이 없으면 BITMAP_ERROR. vm/shm.c 도 같은 swap 공간을 쓴다. */
+size_t
+anon_swap_write (void *kva) {
+	//swap_disk에서 빈 공간 찾기
+	size_t idx = bitmap_scan_and_flip_next_fit(swap_bm, 1, false);
+	if(idx == BITMAP_ERROR) return BITMAP_ERROR;
+
+	// 해당 공간에 disk_write
+	size_t start_sector = idx * SECTOR_UNIT;
+	enum diskstat_user old_user = disk_user_begin(DISKSTAT_SWAP);
+	disk_write_multiple(swap_disk, start_sector, kva, SECTOR_UNIT);
+	disk_user_end(old_user);
+
+	return idx;
+}
+
+/* swap slot IDX 의 내용을 KVA 로 읽고 slot 을 비운다. */
+void
+anon_swap_read (size_t idx, void *kva) {
+	// 스레드가 폴트에 멈춰 있으므로 다른 요청보다 먼저 처리되게 한다.
+	size_t start_sector = idx * SECTOR_UNIT;
+	struct disk_request req;
+	disk_request_init(&req, swap_disk, start_sector, kva, SECTOR_UNIT, false);
+	req.prio = DISK_PRIO_HIGH;
+	req.user = DISKSTAT_SWAP;
+	disk_submit(&req);
+	disk_wait(&req);
+
+	anon_swap_free(idx);
+}
+
+/* swap slot IDX 를 읽지 않고 비운다. */
+void
+anon_swap_free (size_t idx) {
+	bitmap_set(swap_bm, idx, false);
+}
+
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
@@ -1,6 +1,7 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "devices/disk.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
 #include <stdlib.h>
@@ -37,7 +38,9 @@ file_init(struct page *page, void *aux){
 
 	/* 할당받은 페이지에 파일 내용을 읽어 채운다. */
 	void *kpage = page->frame->kva;
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_PAGE_CACHE);
 	size_t read_bytes = file_read_at (file, kpage, page_read_bytes, ofs);
+	disk_user_end (old_user);
 	size_t page_zero_bytes = PGSIZE - read_bytes;
 	memset (kpage + read_bytes, 0, page_zero_bytes);
 
@@ -76,7 +79,9 @@ file_backed_swap_in (struct page *page, void *kva) {
 	off_t ofs = file_page->ofs;
 	size_t page_read_bytes = file_page->page_read_bytes;
 
+	enum diskstat_user old_user = disk_user_begin (DISKSTAT_PAGE_CACHE);
 	size_t read_bytes = file_read_at (file, kva, page_read_bytes, ofs);
+	disk_user_end (old_user);
 	size_t page_zero_bytes = PGSIZE - read_bytes;
 	memset (kva + read_bytes, 0, page_zero_bytes);
 
@@ -181,7 +186,7 @@ do_munmap (void *addr) {
 
 		enum vm_type type = page->operations->type;
 
-		if(type == VM_ANON)
+		if(type == VM_ANON || type == VM_SHM)
 			PANIC("DEBUG : invalid addr type for munmap");
 
 		//FILE이면 last를 file_page에서 찾아옴, UNINIT(FILE 대기)이면 aux에서 찾아옴
@@ -205,6 +210,8 @@ write_back(struct page *page){
 	size_t read_bytes = page->file.page_read_bytes;
 	struct file *file = page->file.file;
 
+	enum diskstat_user old_user = disk_user_begin(DISKSTAT_PAGE_CACHE);
 	if(file_write_at(file, page->frame->kva, read_bytes, ofs) != (int) read_bytes)
 		PANIC("DEBUG : write back 오류 !!! ");
+	disk_user_end(old_user);
 }
\ No newline at end of file
@@ -0,0 +1,330 @@
+/* shm.c: Implementation of anonymous memory shared between processes. */
+
+#include "vm/vm.h"
+#include <round.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+
+/* 공유 객체의 페이지 하나.
+   내용은 프로세스가 아니라 객체가 들고 있어서, 매핑이 몇 개든
+   frame 이나 swap slot 은 하나뿐이다. */
+struct shm_slot {
+	struct frame *frame;     /* 올라와 있으면 그 frame, 아니면 NULL */
+	size_t swap_slot;        /* 내려가 있으면 swap slot, 아니면 BITMAP_ERROR */
+	struct list mappers;     /* 이 페이지를 매핑한 struct page 들 */
+};
+
+/* 공유 객체. 매핑이 모두 사라지면 함께 사라진다. */
+struct shm {
+	int key;                 /* 음수면 이름 없는 객체 (fork 로만 물려줌) */
+	bool listed;             /* shm_list 에서 key 로 찾을 수 있는지 */
+	struct list_elem elem;   /* shm_list */
+	size_t mapper_cnt;       /* 모든 페이지의 매핑 수 */
+	size_t page_cnt;
+	struct shm_slot slots[];
+};
+
+/* key 가 있는 객체들. */
+static struct list shm_list;
+
+/* shm_list 와 모든 객체의 slot 을 보호한다. shm_claim 은 swap 에서
+   읽는 동안에도 잡고 있어서, 같은 페이지를 두 프로세스가 동시에
+   올리거나 내리는 중인 페이지를 읽는 일이 없다. */
+static struct lock shm_lock;
+
+static bool shm_swap_in (struct page *page, void *kva);
+static bool shm_swap_out (struct page *page);
+static void shm_destroy (struct page *page);
+
+static const struct page_operations shm_ops = {
+	.swap_in = shm_swap_in,
+	.swap_out = shm_swap_out,
+	.destroy = shm_destroy,
+	.type = VM_SHM,
+};
+
+void
+vm_shm_init (void) {
+	list_init(&shm_list);
+	lock_init(&shm_lock);
+}
+
+/* shm_claim 의 vm_get_frame 이 다른 공유 페이지를 evict 하거나,
+   attach 를 되돌리면서 destroy 가 불리는 경우처럼 이미 잡고 있을 때가
+   있으므로 그때는 다시 잡지 않는다. 잡았으면 true. */
+static bool
+shm_enter (void) {
+	if (lock_held_by_current_thread(&shm_lock))
+		return false;
+	lock_acquire(&shm_lock);
+	return true;
+}
+
+static void
+shm_leave (bool entered) {
+	if (entered)
+		lock_release(&shm_lock);
+}
+
+static struct shm *
+shm_find (int key) {
+	struct list_elem *e;
+
+	for (e = list_begin(&shm_list); e != list_end(&shm_list); e = list_next(e)) {
+		struct shm *obj = list_entry(e, struct shm, elem);
+		if (obj->key == key)
+			return obj;
+	}
+	return NULL;
+}
+
+static struct shm *
+shm_create (int key, size_t page_cnt) {
+	struct shm *obj = malloc(sizeof *obj + page_cnt * sizeof *obj->slots);
+	if (obj == NULL)
+		return NULL;
+
+	obj->key = key;
+	obj->listed = key >= 0;
+	obj->mapper_cnt = 0;
+	obj->page_cnt = page_cnt;
+	for (size_t i = 0; i < page_cnt; i++) {
+		obj->slots[i].frame = NULL;
+		obj->slots[i].swap_slot = BITMAP_ERROR;
+		list_init(&obj->slots[i].mappers);
+	}
+	if (obj->listed)
+		list_push_back(&shm_list, &obj->elem);
+	return obj;
+}
+
+/* 더 이상 key 로 찾지 못하게 한다. 새 attach 는 새 객체를 만든다. */
+static void
+shm_unlist (struct shm *obj) {
+	if (obj->listed) {
+		list_remove(&obj->elem);
+		obj->listed = false;
+	}
+}
+
+/* 현재 프로세스의 VA 에 OBJ 의 IDX 번째 페이지를 넣는다.
+   frame 은 폴트가 날 때 shm_claim 이 연결한다. */
+static bool
+shm_map (struct shm *obj, size_t idx, void *va, bool writable) {
+	struct thread *curr = thread_current();
+	struct page *page = malloc(sizeof *page);
+	if (page == NULL)
+		return false;
+
+	page->operations = &shm_ops;
+	page->va = va;
+	page->frame = NULL;
+	page->pml4 = curr->pml4;
+	page->writable = writable;
+	page->shm.obj = obj;
+	page->shm.idx = idx;
+	if (!spt_insert_page(&curr->spt, page)) {
+		free(page);
+		return false;
+	}
+
+	list_push_back(&obj->slots[idx].mappers, &page->shm.elem);
+	obj->mapper_cnt++;
+	return true;
+}
+
+/* KEY 라는 이름의 SIZE 바이트 공유 객체를 ADDR 에 붙이고, 없으면
+   0 으로 채워서 만든다. KEY 가 음수면 항상 새 객체를 만들며 fork 한
+   자식만 같이 쓸 수 있다. 검증은 s_shm_attach(호출자)에서 함.
+   크기가 기존 객체와 다르거나 실패하면 NULL. */
+void *
+do_shm_attach (int key, size_t size, void *addr) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	size_t page_cnt = DIV_ROUND_UP(size, PGSIZE);
+	bool entered = shm_enter();
+	struct shm *obj = key >= 0 ? shm_find(key) : NULL;
+	size_t i;
+
+	if (obj == NULL)
+		obj = shm_create(key, page_cnt);
+	if (obj == NULL || obj->page_cnt != page_cnt) {
+		addr = NULL;
+		goto done;
+	}
+
+	for (i = 0; i < page_cnt; i++)
+		if (!shm_map(obj, i, addr + i * PGSIZE, true))
+			break;
+
+	if (i < page_cnt) {
+		//만들다가 실패할 경우 넣었던 매핑 rollback, 마지막 매핑이 빠지면 객체도 정리됨
+		for (size_t j = 0; j < i; j++)
+			spt_remove_page(spt, spt_find_page(spt, addr + j * PGSIZE));
+		if (i == 0 && obj->mapper_cnt == 0) {
+			shm_unlist(obj);
+			free(obj);
+		}
+		addr = NULL;
+	}
+
+done:
+	shm_leave(entered);
+	return addr;
+}
+
+/* ADDR 에 붙인 공유 객체를 뗀다. ADDR 이 attach 의 시작이 아니면 false. */
+bool
+do_shm_detach (void *addr) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct page *page = spt_find_page(spt, addr);
+	if (page == NULL || VM_TYPE(page->operations->type) != VM_SHM
+			|| page->shm.idx != 0)
+		return false;
+
+	struct shm *obj = page->shm.obj;
+	size_t page_cnt = obj->page_cnt;
+
+	/* attach 는 항상 연속된 페이지에 객체 전체를 붙인다 */
+	for (size_t i = 0; i < page_cnt; i++) {
+		page = spt_find_page(spt, addr + i * PGSIZE);
+		ASSERT(page != NULL && page->shm.obj == obj && page->shm.idx == i);
+		spt_remove_page(spt, page);
+	}
+	return true;
+}
+
+/* PAGE 를 frame 에 올리고 매핑한다. 다른 프로세스가 이미 올려 둔
+   페이지면 그 frame 을 같이 쓰고, 아니면 swap 에서 읽거나 0 으로 채운다. */
+bool
+shm_claim (struct page *page) {
+	struct shm_slot *slot = &page->shm.obj->slots[page->shm.idx];
+	bool entered = shm_enter();
+	bool success;
+
+	if (slot->frame == NULL) {
+		struct frame *frame = vm_get_frame();
+
+		// 채우는 동안 clock 이 고르지 않도록 고정
+		frame->pin_cnt++;
+		frame->page = page;
+		if (slot->swap_slot != BITMAP_ERROR) {
+			anon_swap_read(slot->swap_slot, frame->kva);
+			slot->swap_slot = BITMAP_ERROR;
+		} else
+			memset(frame->kva, 0, PGSIZE);
+		frame->pin_cnt--;
+		slot->frame = frame;
+	}
+
+	success = pml4_set_page(page->pml4, page->va, slot->frame->kva, page->writable);
+	if (success)
+		page->frame = slot->frame;
+
+	shm_leave(entered);
+	return success;
+}
+
+/* fork 할 때 부모의 PARENT 와 같은 객체 페이지를 자식에 붙인다.
+   내용은 복사하지 않는다. */
+bool
+shm_copy_page (struct page *parent) {
+	bool entered = shm_enter();
+	bool success = shm_map(parent->shm.obj, parent->shm.idx, parent->va,
+			parent->writable);
+	shm_leave(entered);
+	return success;
+}
+
+/* PAGE 가 가리키는 객체 페이지를 매핑한 프로세스 중 하나라도 최근에
+   접근했는지 보고, accessed bit 을 모두 지운다. clock 이 쓴다. */
+bool
+shm_test_and_clear_accessed (struct page *page) {
+	struct shm_slot *slot = &page->shm.obj->slots[page->shm.idx];
+	bool entered = shm_enter();
+	bool accessed = false;
+	struct list_elem *e;
+
+	for (e = list_begin(&slot->mappers); e != list_end(&slot->mappers); e = list_next(e)) {
+		struct page *p = list_entry(e, struct page, shm.elem);
+		if (pml4_is_accessed(p->pml4, p->va)) {
+			accessed = true;
+			pml4_set_accessed(p->pml4, p->va, false);
+		}
+	}
+
+	shm_leave(entered);
+	return accessed;
+}
+
+/* frame 연결은 shm_claim 이 하므로 vm_do_claim_page 를 거치지 않는다. */
+static bool
+shm_swap_in (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
+}
+
+/* PAGE 의 frame 을 객체의 swap slot 에 기록하고, 매핑한 모든
+   프로세스에서 떼어 낸다. */
+static bool
+shm_swap_out (struct page *page) {
+	struct shm_slot *slot = &page->shm.obj->slots[page->shm.idx];
+	bool entered = shm_enter();
+	struct list_elem *e;
+	size_t idx;
+
+	/* 기록하는 동안 내용이 바뀌지 않도록 매핑부터 끊는다.
+	   그 사이 폴트는 shm_claim 에서 기다렸다가 swap 에서 읽는다. */
+	for (e = list_begin(&slot->mappers); e != list_end(&slot->mappers); e = list_next(e)) {
+		struct page *p = list_entry(e, struct page, shm.elem);
+		if (p->frame != NULL) {
+			pml4_clear_page(p->pml4, p->va);
+			p->frame = NULL;
+		}
+	}
+
+	idx = anon_swap_write(slot->frame->kva);
+	if (idx != BITMAP_ERROR) {
+		slot->swap_slot = idx;
+		slot->frame = NULL;
+	}
+
+	shm_leave(entered);
+	return idx != BITMAP_ERROR;
+}
+
+/* 이 프로세스의 매핑만 뗀다. 마지막 매핑이면 객체 페이지도 정리한다.
+   PAGE will be freed by the caller. */
+static void
+shm_destroy (struct page *page) {
+	struct shm *obj = page->shm.obj;
+	struct shm_slot *slot = &obj->slots[page->shm.idx];
+	bool entered = shm_enter();
+
+	list_remove(&page->shm.elem);
+	pml4_clear_page(page->pml4, page->va);
+
+	if (list_empty(&slot->mappers)) {
+		if (slot->frame != NULL) {
+			list_remove(&slot->frame->frame_elem);
+			palloc_free_page(slot->frame->kva);
+			free(slot->frame);
+			slot->frame = NULL;
+		}
+		if (slot->swap_slot != BITMAP_ERROR) {
+			anon_swap_free(slot->swap_slot);
+			slot->swap_slot = BITMAP_ERROR;
+		}
+		/* attach 는 객체 전체를 붙이므로 빈 페이지가 생겼다면 온전한
+		   attach 는 더 남아 있지 않다. 새 attach 가 반쯤 정리된 객체를
+		   찾지 않게 한다. */
+		shm_unlist(obj);
+	} else if (slot->frame != NULL && slot->frame->page == page)
+		// clock 과 swap_out 은 frame->page 로 slot 을 찾으므로 남은 매핑으로 넘김
+		slot->frame->page = list_entry(list_front(&slot->mappers), struct page, shm.elem);
+
+	if (--obj->mapper_cnt == 0)
+		free(obj);
+
+	shm_leave(entered);
+}
@@ -7,6 +7,8 @@
 #include "lib/kernel/hash.h"
 #include "threads/vaddr.h"
 #include "lib/kernel/list.h"
+#include "threads/interrupt.h"
+#include "devices/timer.h"
 
 static void page_destructor (struct hash_elem *e, void *aux UNUSED);
 /* Global frame list for eviction */
@@ -43,6 +45,7 @@ vm_init (void) {
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init(&frame_list);
+	vm_shm_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -61,6 +64,7 @@ page_get_type (struct page *page) {
 
 /* Helpers */
 static struct frame *vm_get_victim (void);
+static bool frame_test_and_clear_accessed (struct frame *f);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
 
@@ -149,13 +153,20 @@ vm_get_victim (void) {
 
     while (true) {
         struct frame *f = list_entry(clock_hand, struct frame, frame_elem);
-        if (!f->no_victim) {
-            if (!pml4_is_accessed(f->page->pml4, f->page->va)) {
+        if (f->pin_cnt == 0 && !f->evicting && !frame_test_and_clear_accessed(f)) {
+            /* 공유 페이지의 accessed bit 을 보다가 잠들 수 있으니
+               그 사이 pin 되거나 다른 스레드가 골랐는지 다시 확인 */
+            enum intr_level old_level = intr_disable();
+            bool chosen = f->pin_cnt == 0 && !f->evicting;
+            if (chosen)
+                f->evicting = true;
+            intr_set_level(old_level);
+
+            if (chosen) {
                 clock_hand = list_next(clock_hand);
-				victim = f;
+                victim = f;
                 break;
             }
-            pml4_set_accessed(f->page->pml4, f->page->va, false);
         }
 
         clock_hand = list_next(clock_hand);
@@ -166,6 +177,19 @@ vm_get_victim (void) {
 	return victim;
 }
 
+/* F 가 clock 이 지난번에 지나간 뒤로 쓰였는지 보고 accessed bit 을 지운다.
+   공유 페이지는 매핑한 모든 프로세스의 bit 을 본다. */
+static bool
+frame_test_and_clear_accessed (struct frame *f) {
+	if (VM_TYPE(f->page->operations->type) == VM_SHM)
+		return shm_test_and_clear_accessed(f->page);
+
+	if (!pml4_is_accessed(f->page->pml4, f->page->va))
+		return false;
+	pml4_set_accessed(f->page->pml4, f->page->va, false);
+	return true;
+}
+
 /* Evict one page and return the corresponding frame.
  * Return NULL on error.*/
 /* frame 받아서 swap_out 처리하고, 연결 끊어서 다시 사용 */
@@ -180,6 +204,10 @@ vm_evict_frame (void) {
     victim->page->frame = NULL;
     victim->page = NULL;
 
+	/* 새 page 가 쓸 frame 이므로 상태를 처음으로 */
+	victim->pin_cnt = 0;
+	victim->evicting = false;
+
 	return victim;
 }
 
@@ -189,7 +217,7 @@ vm_evict_frame (void) {
  * space.*/
 /* 물리 메모리 확보(frame 확보), 
    남은 user pool 없으면 vm_evict_frame()으로 받아옴 */
-static struct frame *
+struct frame *
 vm_get_frame (void) {
 
 	void *kpage = palloc_get_page(PAL_USER);
@@ -205,6 +233,8 @@ vm_get_frame (void) {
 		
 	f->kva = kpage;
 	f->page = NULL;
+	f->pin_cnt = 0;
+	f->evicting = false;
 	list_push_back(&frame_list, &(f->frame_elem));
 
 	return f;
@@ -273,9 +303,65 @@ vm_claim_page (void *va) {
 	return vm_do_claim_page (page);
 }
 
+/* Make the page at VA resident and keep the clock from choosing
+ * its frame until a matching vm_unpin_page().  Pins nest, since a
+ * shared frame may be pinned by several processes at once.  Used
+ * by system calls so that the file system never faults on a user
+ * buffer while holding its locks.  Returns false if VA is not
+ * mapped. */
+bool
+vm_pin_page (void *va) {
+	struct page *page = spt_find_page(&thread_current()->spt, va);
+	if (page == NULL)
+		return false;
+
+	/* frame 확인과 pin_cnt 증가 사이에 eviction 이 끼어들지 않도록
+	   인터럽트를 끄고 본다. claim 은 디스크 I/O 가 있으니 밖에서. */
+	while (true) {
+		enum intr_level old_level = intr_disable();
+		struct frame *frame = page->frame;
+		if (frame != NULL && !frame->evicting) {
+			frame->pin_cnt++;
+			intr_set_level(old_level);
+			return true;
+		}
+		intr_set_level(old_level);
+
+		/* swap_out 이 기록 중인 frame 에 쓰면 스냅샷 뒤라 사라지고,
+		   끝나면 frame 도 떼이므로 다 내려간 뒤 다시 올린다.
+		   evictor 가 우선순위가 낮을 수 있어 yield 대신 잔다. */
+		if (frame != NULL) {
+			timer_sleep(1);
+			continue;
+		}
+
+		if (!vm_do_claim_page(page))
+			return false;
+	}
+}
+
+/* Drop one pin on the page at VA.  The clock may evict it again
+ * once every vm_pin_page() has been matched. */
+void
+vm_unpin_page (void *va) {
+	struct page *page = spt_find_page(&thread_current()->spt, va);
+	if (page == NULL || page->frame == NULL)
+		return;
+
+	/* 공유 frame 은 여러 프로세스가 같이 pin 하므로 세어서 푼다 */
+	enum intr_level old_level = intr_disable();
+	if (page->frame->pin_cnt > 0)
+		page->frame->pin_cnt--;
+	intr_set_level(old_level);
+}
+
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
+	/* 공유 페이지는 다른 프로세스가 올려 둔 frame 을 같이 쓸 수 있다 */
+	if (VM_TYPE(page->operations->type) == VM_SHM)
+		return shm_claim(page);
+
 	struct frame *frame = vm_get_frame();
     if (frame == NULL)
         goto error;
@@ -357,6 +443,12 @@ supplemental_page_table_copy (struct supplemental_page_table *dst, struct supple
 				memcpy(c_page->frame->kva, p_page->frame->kva, PGSIZE);
 				break;
 
+			case VM_SHM:
+				//복사하지 않고 같은 공유 객체에 붙임
+				if(!shm_copy_page(p_page))
+					return false;
+				break;
+
 			default:
 				return false;
 		}	